@@ -13,16 +13,327 @@
 
 #include<iostream>
 
-#include <cassert> // assert
-#include <cstddef> // ptrdiff_t, size_t
+#include <algorithm> // fill, sort
+
+#include <cstddef> // max_align_t, ptrdiff_t, size_t
+#include <cstdint> // uintptr_t
+#include <cstring> // memcpy
+#include <memory> // align, shared_ptr
 #include <new> // new
 #include <stdexcept> //invalid arg
+
+#include <sys/mman.h> // madvise, mmap, munmap
+
+// ----------------------------------------------
+// ALLOCATOR_HIDE, ALLOCATOR_SHOW, ALLOCATOR_WATCHED
+// ----------------------------------------------
+
+/**
+ * tell ASan which bytes of an arena the program may touch;
+ * check_debug hides redzones and quarantined blocks, so a stray access
+ * is reported where it happens rather than when the block is checked
+ * no-ops unless built with -fsanitize=address
+ * ALLOCATOR_WATCHED is non-zero when hidden bytes are being watched, so
+ * code that pokes them on purpose, like the check_debug tests, can
+ * stand aside
+ */
+#if defined(__SANITIZE_ADDRESS__)
+    #include <sanitizer/asan_interface.h>
+    #define ALLOCATOR_HIDE(p, n) ASAN_POISON_MEMORY_REGION(p, n)
+    #define ALLOCATOR_SHOW(p, n) ASAN_UNPOISON_MEMORY_REGION(p, n)
+    #define ALLOCATOR_WATCHED    1
+#else
+    #define ALLOCATOR_HIDE(p, n) ((void)(p), (void)(n))
+    #define ALLOCATOR_SHOW(p, n) ((void)(p), (void)(n))
+    #define ALLOCATOR_WATCHED    0
+#endif
+
+// ----------
+// log2_floor
+// ----------
+
+/**
+ * compile-time floor(log2(n)), 0 for n < 2
+ */
+template <std::size_t n>
+struct log2_floor {
+    static const std::size_t value = 1 + log2_floor<n / 2>::value;};
+
+template <>
+struct log2_floor<1> {
+    static const std::size_t value = 0;};
+
+template <>
+struct log2_floor<0> {
+    static const std::size_t value = 0;};
+
+// -----------
+// class_count
+// -----------
+
+/**
+ * compile-time number of free-list size classes for an N-byte arena:
+ * small_cls exact classes below small_cls words, then one per power of
+ * two, capped at the width of the bitmap that marks the non-empty ones
+ * a runtime-sized arena (N == 0) gets the cap
+ */
+template <int N>
+struct class_count {
+    static const std::size_t bits      = sizeof(std::size_t) * 8;
+    static const std::size_t small_cls = 16;
+    static const std::size_t small_lg  = log2_floor<small_cls * sizeof(std::size_t)>::value;
+    static const std::size_t n_lg      = (N == 0) ? bits - 1 : log2_floor<N>::value;
+    static const std::size_t all       = small_cls + (n_lg > small_lg ? n_lg - small_lg : 0) + 1;
+    static const std::size_t value     = all < bits ? all : bits;};
+
+// -----------
+// check_level
+// -----------
+
+/**
+ * how much heap checking Allocator does on each operation
+ * check_none:  nothing
+ * check_local: O(1), the sentinels of the block being allocated or
+ *              freed and of its neighbours
+ * check_full:  O(n), valid() after every operation
+ * check_debug: check_local, plus a redzone of guard bytes on each side
+ *              of every payload, checked on free; freed payloads are
+ *              poisoned and held in a quarantine of recently freed
+ *              blocks, checked untouched when they leave it; freeing a
+ *              block twice is caught even while it is quarantined
+ * a failed check throws std::logic_error, NDEBUG or not
+ */
+enum check_level {check_none, check_local, check_full, check_debug};
+
+// ----------
+// fit_policy
+// ----------
+
+/**
+ * which free block Allocator::allocate places a request in
+ * first_fit: the first fitting block of the request's own size class,
+ *            else the head of the next non-empty larger class
+ * next_fit:  the first fitting block in address order from a roving
+ *            pointer left where the previous search stopped
+ * best_fit:  the smallest fitting block; each class's list is kept
+ *            sorted by size, so the first fit found is the best
+ */
+enum fit_policy {first_fit, next_fit, best_fit};
+
+// ----------
+// stats_mode
+// ----------
+
+/**
+ * whether Allocator keeps its O(1) counters (stats_on) or not; with
+ * stats_off, stats() still reports the gauges by walking the arena,
+ * and every counter reads 0
+ */
+enum stats_mode {stats_off, stats_on};
+
+// ---------------
+// allocator_stats
+// ---------------
+
+/**
+ * a snapshot of an arena, as returned by Allocator::stats
+ * sizes are payload bytes; sentinels count toward neither
+ */
+struct allocator_stats {
+    std::size_t bytes_used;   //in-use payload
+    std::size_t bytes_free;   //free payload
+    std::size_t largest_free; //largest free payload, the biggest request that can succeed
+    std::size_t used_blocks;
+    std::size_t free_blocks;
+    std::size_t allocs;       //blocks handed out
+    std::size_t frees;        //blocks taken back
+    std::size_t splits;       //free blocks cut in two
+    std::size_t coalesces;    //blocks merged into a neighbour on free
+    std::size_t failed;       //requests answered with bad_alloc
+};
+
+// -------------
+// arena_control
+// -------------
+
+/**
+ * an arena's free-list heads, roving pointer and counters, kept apart
+ * from its bytes so a runtime-sized arena can hold them in its buffer
+ */
+template <std::size_t K>
+struct arena_control {
+    std::ptrdiff_t  heads[K]; //first free block of each class, -1 if none
+    std::size_t     nonempty; //bit c set iff heads[c] != -1
+    std::size_t     rover;    //next_fit: block where the next search starts; MonotonicAllocator: the top
+    std::size_t     sweep;    //compact: block where the next slice resumes
+    allocator_stats st;       //counters, kept when stats are on
+    std::ptrdiff_t  q_head;   //check_debug: oldest quarantined block, -1 if none
+    std::ptrdiff_t  q_tail;   //check_debug: newest quarantined block, -1 if none
+    std::size_t     q_count;  //check_debug: blocks in quarantine
+};
+
+// -----------
+// arena_store
+// -----------
+
+/**
+ * where an Allocator<T, N> keeps its arena
+ * for N > 0, the N bytes and the control block live in the object
+ * itself, and a copy copies the whole arena; blocks must go back to the
+ * object they came from, so only that object compares equal to itself
+ */
+template <int N, std::size_t A>
+class arena_store {
+    protected:
+        typedef arena_control<class_count<N>::value> control;
+
+        //every sentinel but a trailing odd footer is sntl_size aligned
+        alignas(A) char a[N];
+        control c;
+
+        arena_store () {}
+
+        /**
+         * a rebound copy (e.g. a std::list's node allocator) starts with
+         * its own empty arena
+         */
+        template <int N2, std::size_t A2>
+        explicit arena_store (const arena_store<N2, A2>&) {}
+
+        control& ctl () {
+            return c;}
+
+        const control& ctl () const {
+            return c;}
+
+        static std::size_t size () {
+            return N;}
+
+        /**
+         * the arena lives in the object, so only the object itself holds
+         * it: a copy or a rebound copy holds another, and compares unequal
+         */
+        bool shares (const arena_store& that) const {
+            return this == &that;}};
+
+/**
+ * for N == 0, a runtime-sized arena in a buffer the object only points
+ * to: either the caller's, which must outlive every copy, or an
+ * anonymous mmap region unmapped along with the last copy
+ * the control block sits at the front of the buffer, so a copy is a
+ * few words and every copy, rebound ones included, shares one arena
+ * copies are not synchronized with each other
+ */
+template <std::size_t A>
+class arena_store<0, A> {
+    template <int, std::size_t>
+    friend class arena_store;
+
+    protected:
+        typedef arena_control<class_count<0>::value> control;
+
+        const static std::size_t huge_page= std::size_t(1) << 21;
+
+        std::shared_ptr<char> owner; //the mapping, if this arena made one
+        char*                 a;     //max_align_t aligned
+        std::size_t           n;
+        control*              c;
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * puts the control block at the front of the bytes bytes at p
+         * and the arena behind it; neither is touched beyond the header
+         */
+        void carve (void* p, std::size_t bytes) {
+            if (!std::align(alignof(control), sizeof(control), p, bytes))
+                throw std::invalid_argument("arena buffer too small");
+            c = new (p) control();
+            void* q = c + 1;
+            bytes -= sizeof(control);
+            if (!std::align(alignof(std::max_align_t), 1, q, bytes))
+                throw std::invalid_argument("arena buffer too small");
+            a = static_cast<char*>(q);
+            n = bytes;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * carves the caller's buffer
+         */
+        arena_store (void* p, std::size_t bytes) :
+                owner(), a(0), n(0), c(0) {
+            carve(p, bytes);}
+
+        /**
+         * O(1) in space
+         * O(1) in time; pages are only faulted in once used, so a large
+         * arena costs nothing up front
+         * maps an anonymous region with room for at least bytes bytes of
+         * arena; if huge, backs it with 2 MiB pages, from the hugetlb pool
+         * when it has them, else by asking for transparent huge pages
+         * throws bad_alloc if the region cannot be mapped
+         */
+        arena_store (std::size_t bytes, bool huge) :
+                owner(), a(0), n(0), c(0) {
+            std::size_t len = bytes + sizeof(control) + alignof(control) + alignof(std::max_align_t);
+            if (huge)
+                len = (len + huge_page - 1) / huge_page * huge_page;
+            void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (huge)
+                p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+            if (p == MAP_FAILED) {
+                p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p == MAP_FAILED)
+                    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+                if (huge)
+                    madvise(p, len, MADV_HUGEPAGE);
+#endif
+                }
+            owner.reset(static_cast<char*>(p), [len] (char* q) {munmap(q, len);});
+            carve(p, len);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a rebound copy shares the arena
+         */
+        template <std::size_t A2>
+        explicit arena_store (const arena_store<0, A2>& that) :
+                owner(that.owner), a(that.a), n(that.n), c(that.c) {}
+
+        control& ctl () {
+            return *c;}
+
+        const control& ctl () const {
+            return *c;}
+
+        std::size_t size () const {
+            return n;}
+
+        bool shares (const arena_store& that) const {
+            return a == that.a;}};
+
 // ---------
 // Allocator
 // ---------
 
-template <typename T, int N>
-class Allocator {
+/**
+ * boundary-tag allocator over a fixed arena of N bytes, or for N == 0
+ * over a buffer supplied at run time (see arena_store)
+ * every block is (sentinel, payload, sentinel); a sentinel holds the
+ * payload size, negated while the block is in use
+ * free blocks are threaded onto segregated free lists by size class,
+ * with the (prev, next) links stored in the free payload itself
+ */
+template <typename T, int N, check_level C = check_local, fit_policy F = first_fit, stats_mode S = stats_on>
+class Allocator : private arena_store<N, (alignof(T) > alignof(std::size_t) ? alignof(T) : alignof(std::size_t))> {
+    template <typename, int, check_level, fit_policy, stats_mode>
+    friend class Allocator;
+
     public:
         // --------
         // typedefs
@@ -39,13 +350,23 @@ class Allocator {
         typedef value_type& reference;
         typedef const value_type& const_reference;
 
+        const static size_type hist_bins= sizeof(size_type) * 8; //histogram bins, one per power of two
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef Allocator<U, N, C, F, S> other;};
+
     public:
         // -----------
         // operator ==
         // -----------
 
-        friend bool operator == (const Allocator&, const Allocator&) {
-            return true;} // this is correct
+        friend bool operator == (const Allocator& lhs, const Allocator& rhs) {
+            return lhs.shares(rhs);}
 
         // -----------
         // operator !=
@@ -55,37 +376,327 @@ class Allocator {
             return !(lhs == rhs);}
 
     private:
-        // ----
-        // data
-        // ----
+        // -----
+        // store
+        // -----
+
+        typedef arena_store<N, (alignof(T) > alignof(std::size_t) ? alignof(T) : alignof(std::size_t))> store;
+
+        using store::a;
+        using store::ctl;
+        using store::shares;
+        using store::size;
+
+        // ---------
+        // constants
+        // ---------
 
-        char a[N];
         const static size_type t_size= sizeof(T);
         const static size_type sntl_size= sizeof(size_type);  //sentinel size
-        const static size_type min_blk= 2*(sntl_size)+t_size; //min space req for an allocate
+        const static size_type link_size= sizeof(difference_type); //free-list link size
+        const static size_type min_pay= (t_size > 2 * link_size) ? t_size : 2 * link_size; //a free payload must hold both links
+        const static size_type min_blk= 2*(sntl_size)+min_pay; //min space req for an allocate
+        const static size_type min_any= 2*(sntl_size)+2*link_size; //smallest block any T leaves in a shared arena
+
+        const static size_type small_cls= class_count<N>::small_cls; //exact classes, one per sntl_size bytes
+        const static size_type small_max= small_cls * sntl_size;      //payloads below this use an exact class
+        const static size_type small_lg= class_count<N>::small_lg;
+        const static size_type cls_count= class_count<N>::value;
+
+        const static difference_type nil= -1; //end of a free list
+
+        //check_debug: an in-use payload is (requested bytes, front guard, data, back guard)
+        const static size_type front_rz= (C == check_debug) ? 2 * sntl_size : 0; //word of requested bytes + front guard
+        const static size_type back_rz= (C == check_debug) ? 2 * sntl_size : 0;  //least back guard
+        const static size_type q_max= 64;                    //blocks held in quarantine
+        const static unsigned char guard_byte= 0xfd;         //redzones
+        const static unsigned char poison_byte= 0xdd;        //quarantined data
+        const static size_type freed_mark= ~size_type(0);    //requested bytes of a quarantined block
+
+        // --------
+        // sentinel
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * reads the full-width sentinel at a[i]
+         * memcpy keeps the trailing odd footer well defined;
+         * on an aligned sentinel it is a single load
+         */
+        difference_type sentinel (size_type i) const {
+            difference_type v;
+            std::memcpy(&v, &a[i], sntl_size);
+            return v;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * writes the full-width sentinel v at a[i]
+         */
+        void sentinel (size_type i, difference_type v) {
+            std::memcpy(&a[i], &v, sntl_size);}
+
+        // ---
+        // tag
+        // ---
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * writes both sentinels of the block starting at a[i]
+         */
+        void tag (size_type i, difference_type v) {
+            sentinel(i, v);
+            sentinel(i + sntl_size + (v < 0 ? -v : v), v);}
+
+        // ----
+        // link
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * reads link k (0 = prev, 1 = next) of the free block at a[i]
+         */
+        difference_type link (size_type i, size_type k) const {
+            difference_type v;
+            std::memcpy(&v, &a[i + sntl_size + k * link_size], link_size);
+            return v;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * writes link k (0 = prev, 1 = next) of the free block at a[i]
+         */
+        void link (size_type i, size_type k, difference_type v) {
+            std::memcpy(&a[i + sntl_size + k * link_size], &v, link_size);}
+
+        // -----
+        // count
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * adds d to the counter f when stats are on
+         */
+        void count (std::size_t allocator_stats::* f, difference_type d = 1) {
+            if(S == stats_on)
+              ctl().st.*f+=d;}
+
+        // ----
+        // fail
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * counts a failed request and throws bad_alloc
+         */
+        [[noreturn]] void fail () {
+            count(&allocator_stats::failed);
+            throw std::bad_alloc();}
+
+        // --------
+        // round_up
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * rounds s up to a multiple of sntl_size, so that a split
+         * leaves the next sentinel on an aligned boundary
+         */
+        static size_type round_up (size_type s) {
+            return (s + sntl_size - 1) / sntl_size * sntl_size;}
+
+        // ----------
+        // size_class
+        // ----------
 
-        
-        int& view (char& c) {
-          return *reinterpret_cast<int*>(&c);}
-        char& view (int& i) {
-          return *reinterpret_cast<char*>(&i);}
+        /**
+         * O(1) in space
+         * O(1) in time
+         * payloads below small_max map to an exact class per sntl_size
+         * bytes, larger ones to one class per power of two
+         */
+        static size_type size_class (size_type s) {
+            if (s < small_max)
+                return s / sntl_size;
+            const size_type lg = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(s);
+            const size_type c  = small_cls + lg - small_lg;
+            return c < cls_count ? c : cls_count - 1;}
 
-        //--------
-        //zero_set
-        //--------
+        // ----
+        // push
+        // ----
 
         /**
-         *sets the bytes of sentinel not needed to zero
+         * O(1) in space
+         * O(1) in time, O(length of the class's list) for best_fit
+         * puts the free block at a[i] at the front of its class's list,
+         * or for best_fit in front of the first block at least as large
          */
+        void push (size_type i) {
+            const difference_type s = sentinel(i);
+            const size_type       c = size_class(s);
+            difference_type prev = nil;
+            difference_type next = ctl().heads[c];
+            if (F == best_fit)
+                while (next != nil && sentinel(next) < s) {
+                    prev = next;
+                    next = link(next, 1);}
+            link(i, 0, prev);
+            link(i, 1, next);
+            if (prev != nil)
+                link(prev, 1, i);
+            else
+                ctl().heads[c] = i;
+            if (next != nil)
+                link(next, 0, i);
+            ctl().nonempty |= size_type(1) << c;
+            count(&allocator_stats::free_blocks);
+            count(&allocator_stats::bytes_free, s);}
 
-        void zero_set(size_type index){
-          int k=1;
-          while(k < sntl_size) {
-            a[index+k]=0;
-            ++k;
-          }
-          return;
-        }
+        // ------
+        // unlink
+        // ------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * takes the free block at a[i] off its class's list
+         */
+        void unlink (size_type i) {
+            const size_type       c    = size_class(sentinel(i));
+            const difference_type prev = link(i, 0);
+            const difference_type next = link(i, 1);
+            if (prev != nil)
+                link(prev, 1, next);
+            else
+                ctl().heads[c] = next;
+            if (next != nil)
+                link(next, 0, prev);
+            if (ctl().heads[c] == nil)
+                ctl().nonempty &= ~(size_type(1) << c);
+            count(&allocator_stats::free_blocks, -1);
+            count(&allocator_stats::bytes_free, -sentinel(i));}
+
+        // ----
+        // take
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * marks the unlisted free block at a[i] in use for spc bytes
+         * after allocation there must be enough space left for a valid block,
+         * else the entire free block is handed out
+         */
+        void take (size_type i, size_type spc) {
+            const size_type need=round_up(spc < min_pay ? min_pay : spc); //must hold links once freed
+            const size_type s=sentinel(i);
+            count(&allocator_stats::allocs);
+            count(&allocator_stats::used_blocks);
+            if(s >= need + min_blk) {
+              count(&allocator_stats::splits);
+              tag(i, -(difference_type)need);
+              const size_type r=i + need + (2 * sntl_size);	//remainder free block
+              tag(r, s - need - (2 * sntl_size));
+              push(r);
+            }
+            else
+              tag(i, -(difference_type)s);}	//give the entire free block in this case
+
+        // -------
+        // aligned
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * returns where the header must go for a payload carved from the
+         * free block at a[i] to start on an al-byte address; the gap in
+         * front is either empty or big enough to stand as a free block
+         * returns nil if spc bytes no longer fit behind that header
+         */
+        difference_type aligned (size_type i, size_type spc, size_type al) const {
+            const size_type p=i + sntl_size;
+            const size_type mis=reinterpret_cast<std::uintptr_t>(&a[p + front_rz]) % al;
+            size_type q=(mis == 0) ? p : p + al - mis;
+            if(q != p && q - p < min_blk)
+              q+=(min_blk - (q - p) + al - 1) / al * al;
+            if(q + front_rz + spc + back_rz > p + sentinel(i))
+              return nil;
+            return q - sntl_size;}
+
+        // ----
+        // find
+        // ----
+
+        /**
+         * O(1) in space
+         * first_fit, best_fit: O(1) in time below small_max bytes,
+         * O(length of one class's list) otherwise
+         * next_fit: O(n) in time
+         * returns the free block F places spc bytes in, nil if none fits
+         */
+        difference_type find (size_type spc) {
+            if(F == next_fit) {
+              size_type i=ctl().rover;
+              do {
+                const difference_type v=sentinel(i);
+                if(v > 0 && (size_type)v >= spc)
+                  return ctl().rover=i;
+                i+=(v < 0 ? -v : v) + (2 * sntl_size);
+                if(i >= size())
+                  i=0;
+              } while(i != ctl().rover);
+              return nil;
+            }
+
+            const size_type c=size_class(spc);
+            for(difference_type j=ctl().heads[c]; j != nil; j=link(j, 1))
+              if((size_type)sentinel(j) >= spc)
+                return j;
+            const size_type bigger=(c + 1 < cls_count) ? ctl().nonempty & (~size_type(0) << (c + 1)) : 0;
+            if(bigger == 0)
+              return nil;
+            return ctl().heads[__builtin_ctzl(bigger)];}
+
+        // -----------
+        // check_block
+        // -----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * at check_local and above, ensures the block at a[i] lies in
+         * the arena and its footer matches its header
+         */
+        void check_block (size_type i) const {
+            if(C == check_none)
+              return;
+            if(i > size() - min_any)
+              throw std::logic_error("Allocator: block outside the arena");
+            const difference_type v=sentinel(i);
+            const size_type s=v < 0 ? -v : v;
+            if(s == 0 || s > size() - i - 2*sntl_size || sentinel(i + sntl_size + s) != v)
+              throw std::logic_error("Allocator: header/footer mismatch");}
+
+        // ---------
+        // check_all
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * at check_full, ensures the whole arena is valid
+         */
+        void check_all () const {
+            if(C == check_full && !valid())
+              throw std::logic_error("Allocator: heap corrupted");}
 
         // -----
         // valid
@@ -95,34 +706,340 @@ class Allocator {
          * O(1) in space
          * O(n) in time
          * iterates through the array, ensuring the sentinels
-         * match in size and sign.
+         * match in size and sign and that no two free blocks touch,
+         * then walks the free lists, ensuring they hold exactly the
+         * free blocks, each in its own class
          */
         bool valid () const{
-            int i=0;
-            int str_sntl=0;
-            int end_sntl=0;
-            bool str_neg=false;
-            bool end_neg=false;
-
-            while(i < N) {
-              str_sntl=(int)a[i];
-              if(str_sntl < 0) {
-                str_sntl=abs(str_sntl); //look for easy negate
-                str_neg=true;
-              }
-              end_sntl=(int)a[i+sntl_size+str_sntl];
-              if(end_sntl < 0) {
-                end_sntl=abs(end_sntl); //again, look for easy (-)
-                end_neg=true;
-              }
-              if( (str_sntl != end_sntl) || ( end_neg != str_neg ) )
+            size_type i=0;
+            size_type free_blks=0;
+            bool prev_free=false;
+
+            while(i < size()) {
+              if(size() - i < min_any)
+                return false;
+              const difference_type str_sntl=sentinel(i);
+              const size_type s=str_sntl < 0 ? -str_sntl : str_sntl;
+              if(s == 0 || s > size() - i - 2*sntl_size)
+                return false;
+              if(sentinel(i + sntl_size + s) != str_sntl)
                 return false;
-              i+=str_sntl+(2*sntl_size);	//set i past (sentinel,block,sentinel)
+              if(str_sntl > 0) {
+                if(prev_free)
+                  return false;	//should have been coalesced
+                ++free_blks;
+              }
+              prev_free=(str_sntl > 0);
+              i+=s+(2*sntl_size);	//set i past (sentinel,block,sentinel)
             }
-            if(i!=N)
+            if(i!=size())
               return false;
+
+            size_type listed=0;
+            for(size_type c=0; c < cls_count; ++c) {
+              if(((ctl().nonempty >> c) & 1) != (ctl().heads[c] != nil))
+                return false;
+              difference_type prev=nil;
+              for(difference_type j=ctl().heads[c]; j != nil; j=link(j, 1)) {
+                if(sentinel(j) <= 0 || size_class(sentinel(j)) != c || link(j, 0) != prev)
+                  return false;
+                if(F == best_fit && prev != nil && sentinel(prev) > sentinel(j))
+                  return false;	//best_fit lists are sorted by size
+                if(++listed > free_blks)
+                  return false;
+                prev=j;
+              }
+            }
+            return listed == free_blks;}
+
+        // ----------
+        // check_busy
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * returns the header of p's block; at check_local and above first
+         * ensures p lies in the arena, its block and both neighbours are
+         * well formed, and the block is not already free
+         */
+        size_type check_busy (pointer p) const {
+            const size_type i=reinterpret_cast<const char*>(p) - a - sntl_size - front_rz;
+            if(C != check_none) {
+              if(reinterpret_cast<const char*>(p) < a + sntl_size + front_rz || reinterpret_cast<const char*>(p) >= a + size())
+                throw std::logic_error("Allocator: pointer outside the arena");
+              check_block(i);
+              const difference_type v=sentinel(i);
+              if(v > 0)
+                throw std::logic_error("Allocator: block is already free");
+              if(i > 0) {
+                const difference_type u=sentinel(i - sntl_size);
+                const size_type prev_s=u < 0 ? -u : u;
+                if(prev_s + (2 * sntl_size) > i)
+                  throw std::logic_error("Allocator: header/footer mismatch");
+                check_block(i - (2 * sntl_size) - prev_s);
+              }
+              const size_type j=i + (size_type)-v + (2 * sntl_size);	//next block
+              if(j < size())
+                check_block(j);
+            }
+            return i;}
+
+        // --------
+        // retarget
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * moves the rover and the compaction sweep to the block at a[to]
+         * if either lies in [lo, hi), a span that stops being a block
+         * boundary
+         */
+        void retarget (size_type lo, size_type hi, size_type to) {
+            if(ctl().rover >= lo && ctl().rover < hi)
+              ctl().rover=to;
+            if(ctl().sweep >= lo && ctl().sweep < hi)
+              ctl().sweep=to;}
+
+        // -------
+        // release
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * frees the s payload bytes behind the header at a[i], which may
+         * span several in-use blocks, coalescing with a free block on
+         * either side and putting the result on its list
+         */
+        void release (size_type i, size_type s) {
+            if(i > 0 && sentinel(i - sntl_size) > 0) {
+              const size_type prev_s=sentinel(i - sntl_size);
+              i-=prev_s + (2 * sntl_size);			//i now set to beginning of prev block
+              unlink(i);
+              count(&allocator_stats::coalesces);
+              s+=prev_s + (2 * sntl_size);			//s now size of prev & current block
+            }
+
+            const size_type j=i + s + (2 * sntl_size);
+            if(j < size() && sentinel(j) > 0) {
+              const size_type next_s=sentinel(j);
+              unlink(j);
+              count(&allocator_stats::coalesces);
+              s+=next_s + (2 * sntl_size);			//s now size of current & next block
+            }
+            retarget(i + 1, i + s + (2 * sntl_size), i);		//keep the cursors on a block boundary
+
+            tag(i, s);
+            push(i);}
+
+        // -------------
+        // place_aligned
+        // -------------
+
+        /**
+         * O(1) in space
+         * O(length of the lists scanned) in time; the first non-empty
+         * class whose smallest block covers spc + al + min_blk ends the scan
+         * carves n elements starting on an al-byte address, al > sntl_size,
+         * from the first free block with room for the padding too
+         * returns 0 if none has
+         */
+        pointer place_aligned (size_type n, size_type al) {
+            const size_type spc=n * t_size;		//bytes requested
+            for(size_type m=ctl().nonempty & (~size_type(0) << size_class(spc)); m != 0; m&=m - 1) {
+              for(difference_type j=ctl().heads[__builtin_ctzl(m)]; j != nil; j=link(j, 1)) {
+                const difference_type h=aligned(j, spc, al);
+                if(h == nil)
+                  continue;
+                check_block(j);
+                unlink(j);
+                if(h != j) {
+                  count(&allocator_stats::splits);
+                  const size_type s=sentinel(j);
+                  tag(j, h - j - (2 * sntl_size));	//padding stands as a free block
+                  push(j);
+                  tag(h, s - (h - j));
+                }
+                take(h, front_rz + spc + back_rz);
+                if(C == check_debug)
+                  arm(h, spc);
+                check_all();
+                return reinterpret_cast<pointer>(&a[h + sntl_size + front_rz]);
+              }
+            }
+            if(C == check_debug && ctl().q_count != 0) {
+              flush();					//the quarantine may hold the room
+              return place_aligned(n, al);
+            }
+            return 0;}
+
+        // -----
+        // slide
+        // -----
+
+        /**
+         * O(1) in space
+         * O(payload) in time
+         * moves the in-use block at a[i] down into the free block right in
+         * front of it, so that free space ends up behind the block and
+         * coalesces with a free block there; returns the new header, or i
+         * if the block in front is in use or the move would misalign T
+         */
+        size_type slide (size_type i) {
+            if(i == 0 || sentinel(i - sntl_size) <= 0)
+              return i;
+            const size_type f=sentinel(i - sntl_size);
+            const size_type j=i - f - (2 * sntl_size);		//the free block in front
+            if(alignof(T) > sntl_size && reinterpret_cast<std::uintptr_t>(&a[j + sntl_size]) % alignof(T) != 0)
+              return i;
+            check_block(j);
+            const size_type s=-sentinel(i);
+            unlink(j);
+            std::memmove(&a[j + sntl_size], &a[i + sntl_size], s);
+            tag(j, -(difference_type)s);
+            const size_type k=j + s + (2 * sntl_size);		//the free space, now behind
+            retarget(j + 1, k, j);
+            release(k, f);
+            return j;}
+
+        // ------
+        // filled
+        // ------
+
+        /**
+         * O(1) in space
+         * O(len) in time
+         * whether the len bytes at a[b] all hold c
+         */
+        bool filled (size_type b, size_type len, unsigned char c) const {
+            for(size_type k=0; k != len; ++k)
+              if((unsigned char)a[b + k] != c)
+                return false;
             return true;}
 
+        // ---
+        // arm
+        // ---
+
+        /**
+         * O(1) in space
+         * O(redzone) in time
+         * check_debug: records the spc bytes requested in the in-use block
+         * at a[i], fills the redzones on either side with guard bytes and
+         * hides them from ASan
+         */
+        void arm (size_type i, size_type spc) {
+            const size_type b=i + sntl_size;		//payload
+            const size_type s=-sentinel(i);
+            std::memcpy(&a[b], &spc, sntl_size);
+            std::memset(&a[b + sntl_size], guard_byte, front_rz - sntl_size);
+            std::memset(&a[b + front_rz + spc], guard_byte, s - front_rz - spc);
+            ALLOCATOR_HIDE(&a[b], front_rz);
+            ALLOCATOR_HIDE(&a[b + front_rz + spc], s - front_rz - spc);}
+
+        // ----------
+        // quarantine
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(payload) in time
+         * check_debug: frees the block at a[i] by way of the quarantine:
+         * checks it was not freed already and that both redzones are
+         * intact, poisons everything behind its (freed mark, next in
+         * quarantine) words, hides it, and queues it; the oldest block
+         * leaves once the quarantine holds more than q_max
+         */
+        void quarantine (size_type i) {
+            const size_type b=i + sntl_size;		//payload
+            const size_type s=-sentinel(i);
+            ALLOCATOR_SHOW(&a[b], s);
+            size_type spc;
+            std::memcpy(&spc, &a[b], sntl_size);
+            if(spc == freed_mark) {
+              ALLOCATOR_HIDE(&a[b], s);
+              throw std::logic_error("Allocator: block is already free");
+            }
+            if(spc > s - front_rz || !filled(b + sntl_size, front_rz - sntl_size, guard_byte) || !filled(b + front_rz + spc, s - front_rz - spc, guard_byte)) {
+              ALLOCATOR_HIDE(&a[b], s);
+              throw std::logic_error("Allocator: redzone overwritten");
+            }
+            const size_type       mark=freed_mark;
+            const difference_type end=nil;
+            std::memcpy(&a[b], &mark, sntl_size);
+            std::memcpy(&a[b + sntl_size], &end, sntl_size);
+            std::memset(&a[b + front_rz], poison_byte, s - front_rz);
+            ALLOCATOR_HIDE(&a[b], s);
+
+            const difference_type t=ctl().q_tail;
+            if(t != nil) {
+              ALLOCATOR_SHOW(&a[t + (2 * sntl_size)], sntl_size);
+              std::memcpy(&a[t + (2 * sntl_size)], &i, sntl_size);
+              ALLOCATOR_HIDE(&a[t + (2 * sntl_size)], sntl_size);
+            }
+            else
+              ctl().q_head=i;
+            ctl().q_tail=i;
+            if(++ctl().q_count > q_max)
+              evict();}
+
+        // -----
+        // evict
+        // -----
+
+        /**
+         * O(1) in space
+         * O(payload) in time
+         * check_debug: takes the oldest block out of quarantine, checks its
+         * poison is untouched, and frees it for real
+         */
+        void evict () {
+            const size_type i=ctl().q_head;
+            const size_type b=i + sntl_size;		//payload
+            const size_type s=-sentinel(i);
+            ALLOCATOR_SHOW(&a[b], s);
+            if(!filled(b + front_rz, s - front_rz, poison_byte))
+              throw std::logic_error("Allocator: block written after free");
+            std::memcpy(&ctl().q_head, &a[b + sntl_size], sntl_size);
+            if(ctl().q_head == nil)
+              ctl().q_tail=nil;
+            --ctl().q_count;
+            release(i, s);
+            count(&allocator_stats::frees);
+            count(&allocator_stats::used_blocks, -1);}
+
+        // ------
+        // format
+        // ------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * empties the free lists and counters and makes the whole arena
+         * one free block; at check_debug, first shows any bytes a previous
+         * arena at the same address left hidden
+         * throws invalid_argument if a runtime-sized arena cannot hold one
+         */
+        void format () {
+            static_assert(cls_count <= sizeof(size_type) * 8, "too many size classes for the bitmap");
+            if(size() < min_blk)
+              throw std::invalid_argument("arena too small for a single block");
+            if(C == check_debug)
+              ALLOCATOR_SHOW(a, size());
+            for(size_type c=0; c < cls_count; ++c)
+              ctl().heads[c]=nil;
+            ctl().nonempty=0;
+            ctl().rover=0;
+            ctl().sweep=0;
+            ctl().st=allocator_stats();
+            ctl().q_head=nil;
+            ctl().q_tail=nil;
+            ctl().q_count=0;
+            tag(0, size()-(2*sntl_size));
+            push(0);
+            check_all();}
 
     public:
         // ------------
@@ -134,14 +1051,50 @@ class Allocator {
          * O(1) in time
          * Initiates the sentinels of the array
          * to N - size of both sentinels
+         * and puts that one free block on its list
          */
         Allocator () {
-            int sntlV=N-(2*sntl_size);
-            a[0]=view(sntlV);			//set first sentinel
-            zero_set(0);
-            a[sntl_size+sntlV]=view(sntlV);
-            zero_set(sntlV + sntl_size);//not sure if necessary...
-            assert(valid());}
+            static_assert(N != 0, "a runtime-sized arena needs a buffer or a size");
+            static_assert(N >= (int)min_blk, "arena too small for a single block");
+            format();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, formats the caller's buffer of bytes bytes, control
+         * block included; the buffer must outlive every copy
+         * throws invalid_argument if it cannot hold a single block
+         */
+        Allocator (void* p, size_type bytes) :
+                store(p, bytes) {
+            static_assert(N == 0, "only a runtime-sized arena takes a buffer");
+            format();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, formats an anonymous mmap region holding at least
+         * bytes bytes, on huge pages if huge; see arena_store
+         * throws bad_alloc if the region cannot be mapped
+         */
+        explicit Allocator (size_type bytes, bool huge = false) :
+                store(bytes, huge) {
+            static_assert(N == 0, "only a runtime-sized arena takes a size");
+            format();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N > 0 an arena holds a single element type, so a rebound
+         * copy (e.g. a std::list's node allocator) starts with its own
+         * empty arena, and compares unequal; for N == 0 it shares the arena, which containers
+         * that rebind temporary copies (std::unordered_map) rely on
+         */
+        template <typename U>
+        explicit Allocator (const Allocator<U, N, C, F, S>& that) :
+                store(static_cast<const typename Allocator<U, N, C, F, S>::store&>(that)) {
+            if(N != 0)
+              format();}
 
         // Default copy, destructor, and copy assignment
         // Allocator (const Allocator&);
@@ -154,62 +1107,150 @@ class Allocator {
 
         /**
          * O(1) in space
-         * O(n) in time
-         * <your documentation>
-         * after allocation there must be enough space left for a valid block
-         * the smallest allowable block is sizeof(T) + (2 * sizeof(int))
-         * choose the first block that fits
+         * O(1) in time for requests below small_max bytes,
+         * O(length of one class's list) otherwise, O(n) for next_fit
+         * places the request in the free block find picks for F
+         * after allocation there must be enough space left for a valid block,
+         * else the entire free block is handed out
+         * the chosen block is checked at check_local
          */
         pointer allocate (size_type n) {
-            if(n <= 0 || (n*t_size) > (N-(2*sntl_size)))
-              throw std::bad_alloc();
-
-            int tmp=0;
-            int spc=n * t_size;      //blocks requested
-            int tmp_spc=0;
-            
-            int i=0;
-  
-            while(i < N) {
-              tmp=(int)a[i];				//next block's sentinel value
-
-              if(tmp > 0 && (tmp - spc ) >= min_blk) {
-                tmp_spc=0-spc;			//new sentinel's value
-
-                a[i]=view(tmp_spc);
-                zero_set(i);
-                a[i + sntl_size + spc]=view(tmp_spc);
-                zero_set(i + sntl_size + spc);
-
-                tmp-=(sntl_size + spc + sntl_size);	//remainder free blocks
-                a[i + sntl_size + spc + sntl_size]=view(tmp);
-                zero_set(i + sntl_size + spc + sntl_size);
-                a[i + (3 * sntl_size) + spc  + tmp]=view(tmp);
-                zero_set(i + (3 * sntl_size) + spc + tmp);
-
-                assert(valid());
-                return reinterpret_cast<pointer>(&a[i + sntl_size]);
+            const pointer p=try_allocate(n);
+            if(p == 0)
+              fail();
+            return p;}
+
+        // ------------
+        // try_allocate
+        // ------------
+
+        /**
+         * O(1) in space
+         * same time as allocate
+         * allocate, but returns 0 instead of throwing when the request
+         * does not fit, and does not count it as failed
+         */
+        pointer try_allocate (size_type n) {
+            if(n <= 0 || n > (size()-(2*sntl_size)) / t_size)
+              return 0;
+            if(alignof(T) > sntl_size)
+              return place_aligned(n, alignof(T));
+
+            const size_type spc=n * t_size;		//bytes requested
+            difference_type i=find(front_rz + spc + back_rz);
+            if(i == nil && C == check_debug && ctl().q_count != 0) {
+              flush();					//the quarantine may hold the room
+              i=find(front_rz + spc + back_rz);
+            }
+            if(i == nil)
+              return 0;
+
+            check_block(i);
+            unlink(i);
+            take(i, front_rz + spc + back_rz);
+            if(C == check_debug)
+              arm(i, spc);
+            check_all();
+            return reinterpret_cast<pointer>(&a[i + sntl_size + front_rz]);}
+
+        // ----------------
+        // allocate_aligned
+        // ----------------
+
+        /**
+         * O(1) in space
+         * O(length of the lists scanned) in time; the first non-empty
+         * class whose smallest block covers spc + al + min_blk ends the scan
+         * returns n elements starting on an al-byte address, al a power of two
+         * the padding in front of the payload becomes a free block of its
+         * own, so deallocate needs nothing special
+         */
+        pointer allocate_aligned (size_type n, size_type al) {
+            if(al == 0 || (al & (al - 1)) != 0)
+              throw std::invalid_argument("alignment must be a power of two");
+            if(al < alignof(T))
+              al=alignof(T);
+            if(al <= sntl_size && alignof(T) <= sntl_size)
+              return allocate(n);
+            if(n <= 0 || n > (size()-(2*sntl_size)) / t_size)
+              fail();
+            const pointer p=place_aligned(n, al);
+            if(p == 0)
+              fail();
+            return p;}
+
+        // ----------
+        // allocate_n
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(k) in time, plus one search per free block used
+         * fills out[0..k) with k blocks of n elements, carving them back
+         * to back from as few free blocks as possible: first one that
+         * holds the whole batch, else one after another that hold at
+         * least one block each
+         * all or nothing: if the arena runs out, the blocks already carved
+         * are freed and bad_alloc is thrown
+         */
+        void allocate_n (size_type n, pointer* out, size_type k) {
+            if(alignof(T) > sntl_size || C == check_debug) {
+              size_type m=0;
+              try {
+                for(; m != k; ++m)
+                  out[m]=allocate(n);
+              }
+              catch(std::bad_alloc&) {
+                deallocate_n(out, n, m);		//all or nothing here too
+                throw;
               }
-              i=abs(tmp) + (2 *  sntl_size);
+              return;
             }
-            i=0;
-            tmp_spc=0;
-            while(i < N) {
-              tmp=(int)a[i];
-              if(tmp > 0 && (tmp - spc) >= 0) {		//less than minblk would remain
-                tmp_spc-= tmp;
-                a[i]=view(tmp_spc); //give the entire free block in this case
-                zero_set(i);
-                a[i + sntl_size + tmp]=view(tmp_spc);
-                zero_set(i + sntl_size + tmp);
-
-                assert(valid());
-                return reinterpret_cast<pointer>(&a[i + sntl_size]);
+            if(n <= 0 || n > (size()-(2*sntl_size)) / t_size)
+              fail();
+
+            const size_type spc=n * t_size;		//bytes requested
+            const size_type need=round_up(spc < min_pay ? min_pay : spc);
+            const size_type stride=need + (2 * sntl_size);
+            size_type got=0;
+            while(got != k) {
+              difference_type i=nil;
+              if((k - got) <= (size() / stride))
+                i=find((k - got) * stride - (2 * sntl_size));
+              if(i == nil)
+                i=find(spc);
+              if(i == nil) {
+                deallocate_n(out, n, got);
+                fail();
+              }
+              check_block(i);
+              unlink(i);
+              size_type s=sentinel(i);
+              for(;;) {
+                if(got != k && s >= need + min_blk) {
+                  count(&allocator_stats::splits);
+                  tag(i, -(difference_type)need);
+                  out[got++]=reinterpret_cast<pointer>(&a[i + sntl_size]);
+                  count(&allocator_stats::allocs);
+                  count(&allocator_stats::used_blocks);
+                  i+=stride;
+                  s-=stride;
+                }
+                else if(got != k && s >= spc) {
+                  tag(i, -(difference_type)s);		//give the entire free block in this case
+                  out[got++]=reinterpret_cast<pointer>(&a[i + sntl_size]);
+                  count(&allocator_stats::allocs);
+                  count(&allocator_stats::used_blocks);
+                  break;
+                }
+                else {
+                  tag(i, s);				//remainder free block
+                  push(i);
+                  break;
+                }
               }
-              i+=abs(tmp) + (2 * sntl_size);
             }
-            throw std::bad_alloc(); //if no return w/in while, alloc failed
-            return 0;}
+            check_all();}
 
         // ---------
         // construct
@@ -222,7 +1263,7 @@ class Allocator {
          */
         void construct (pointer p, const_reference v) {
             new (p) T(v); // this is correct and exempt
-            assert(valid());} // from the prohibition of new
+            check_all();} // from the prohibition of new
 
         // ----------
         // deallocate
@@ -233,48 +1274,319 @@ class Allocator {
          * O(1) in time
          * the sentinel values of the block are reset to positive
          * the previous and next blocks (if they exist) are checked
-         * if either block is a free block, it is coalesced with the
-         * current block which begins at p 
-         * after deallocation adjacent free blocks must be coalesced
+         * if either block is a free block, it is taken off its list and
+         * coalesced with the current block which begins at p
+         * the coalesced block goes onto the list for its size
+         * at check_local, p's block and both neighbours are checked, and
+         * freeing a block that is already free throws
          */
         void deallocate (pointer p, size_type) {
-            int i=reinterpret_cast<char*>(p) - a;            
-            assert(&a[i] == reinterpret_cast<char*>(p));
-            int sntlV=(int)a[i - sntl_size];
-            assert(sntlV < 0);
-
-            sntlV=abs(sntlV);
-            int tmp_sntlV=0;
-            if((i-sntl_size) >= min_blk && (int)a[i-(2*sntl_size)] >= 0) {
-              tmp_sntlV=(int)a[i - (2*sntl_size)];
-              assert(tmp_sntlV == (int)a[i - (3*sntl_size) - tmp_sntlV]);
-              
-              sntlV+=(2 * sntl_size) + tmp_sntlV;			//sntlV now size of prev block & current (just deallocated) block
-              i-= (2 * sntl_size - tmp_sntlV);				//i now set to beginning of new block (from prev + current)
+            const size_type i=check_busy(p);
+            if(C == check_debug) {
+              quarantine(i);
+              check_all();
+              return;
+            }
+            release(i, -sentinel(i));
+            count(&allocator_stats::frees);
+            count(&allocator_stats::used_blocks, -1);
+            check_all();}
+
+        // ------------
+        // deallocate_n
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(k log k) in time
+         * frees the k blocks p[0..k), each of n elements, sorting p by
+         * address so that blocks lying next to each other are merged in a
+         * single sweep: each run of adjacent blocks is tagged, coalesced
+         * with its free neighbours and listed once
+         * p is left sorted; at check_local, repeated pointers throw
+         */
+        void deallocate_n (pointer* p, size_type n, size_type k) {
+            std::sort(p, p + k);
+            if(C == check_debug) {
+              for(size_type m=0; m != k; ++m)
+                deallocate(p[m], n);
+              return;
+            }
+            size_type i=0;
+            size_type s=0;
+            for(size_type m=0; m != k; ++m) {
+              if(C != check_none && m > 0 && p[m] == p[m - 1])
+                throw std::logic_error("Allocator: block is already free");
+              const size_type j=check_busy(p[m]);
+              const size_type t=-sentinel(j);
+              count(&allocator_stats::frees);
+              count(&allocator_stats::used_blocks, -1);
+              if(m > 0 && i + s + (2 * sntl_size) == j) {
+                s+=t + (2 * sntl_size);				//extend the run
+                count(&allocator_stats::coalesces);
+              }
+              else {
+                if(m > 0)
+                  release(i, s);
+                i=j;
+                s=t;
+              }
+            }
+            if(k > 0)
+              release(i, s);
+            check_all();}
+
+        // ----------
+        // try_expand
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * grows p's block from old_n to new_n elements without moving it,
+         * taking what it needs from the free block right behind it and
+         * leaving the rest of that block free
+         * returns false, changing nothing, if that block is in use or too
+         * small; the caller then allocates, copies and frees as usual
+         * always false at check_debug, whose redzones fix a block's extent
+         */
+        bool try_expand (pointer p, size_type, size_type new_n) {
+            if(C == check_debug)
+              return false;
+            const size_type i=check_busy(p);
+            const size_type s=-sentinel(i);
+            if(new_n > (size()-(2*sntl_size)) / t_size)
+              return false;
+            const size_type need=round_up(new_n * t_size < min_pay ? min_pay : new_n * t_size);
+            if(need <= s)
+              return true;
+            const size_type j=i + s + (2 * sntl_size);	//next block
+            if(j >= size() || sentinel(j) <= 0)
+              return false;
+            const size_type total=s + (2 * sntl_size) + sentinel(j);	//both blocks as one payload
+            if(total < need)
+              return false;
+
+            check_block(j);
+            unlink(j);
+            count(&allocator_stats::coalesces);
+            if(total >= need + min_blk) {
+              count(&allocator_stats::splits);
+              tag(i, -(difference_type)need);
+              const size_type r=i + need + (2 * sntl_size);	//remainder free block
+              tag(r, total - need - (2 * sntl_size));
+              push(r);
+              retarget(j, j + 1, r);
             }
+            else {
+              tag(i, -(difference_type)total);
+              retarget(j, j + 1, i);
+            }
+            check_all();
+            return true;}
 
-            if(N-(i+sntlV+sntl_size) >= min_blk && (int)a[i + sntlV + sntl_size] >= 0) {
-              tmp_sntlV=(int)a[i + sntlV + sntl_size];
-              assert(tmp_sntlV == (int)a[i + tmp_sntlV +sntlV+ (2 * sntl_size)]);
+        // ---------------
+        // shrink_in_place
+        // ---------------
 
-              sntlV+=(2 * sntl_size) + tmp_sntlV;			//sntlV now size of current(just deallocated) & next block
-	    }
+        /**
+         * O(1) in space
+         * O(1) in time
+         * shrinks p's block from old_n to new_n elements, new_n > 0,
+         * without moving it, freeing the tail: the tail joins the block
+         * behind it if that one is free, else stands as a free block of
+         * its own if it is big enough for one
+         * returns whether any bytes were freed; always false at check_debug
+         */
+        bool shrink_in_place (pointer p, size_type, size_type new_n) {
+            if(C == check_debug)
+              return false;
+            const size_type i=check_busy(p);
+            const size_type s=-sentinel(i);
+            const size_type need=round_up(new_n * t_size < min_pay ? min_pay : new_n * t_size);
+            if(need >= s)
+              return false;
+            const size_type j=i + s + (2 * sntl_size);	//next block
+            const size_type r=i + need + (2 * sntl_size);	//where the freed tail starts
+            if(j < size() && sentinel(j) > 0) {
+              check_block(j);
+              const size_type next_s=sentinel(j);
+              unlink(j);
+              count(&allocator_stats::coalesces);
+              tag(i, -(difference_type)need);
+              tag(r, next_s + (s - need));
+              push(r);
+              retarget(j, j + 1, r);
+            }
+            else if(s >= need + min_blk) {
+              count(&allocator_stats::splits);
+              tag(i, -(difference_type)need);
+              tag(r, s - need - (2 * sntl_size));
+              push(r);
+            }
+            else
+              return false;
+            check_all();
+            return true;}
 
-            a[i - sntl_size] = view(sntlV);
-            zero_set(i - sntl_size);
-            a[i + sntlV] = view(sntlV);
-            zero_set(i + sntlV);
-            assert(valid());
-        }
+        // -----
+        // flush
+        // -----
+
+        /**
+         * O(1) in space
+         * O(quarantined bytes) in time
+         * check_debug: frees every quarantined block, checking each is
+         * untouched; a no-op at other levels
+         */
+        void flush () {
+            while(C == check_debug && ctl().q_count != 0)
+              evict();
+            check_all();}
+
+        // -------
+        // compact
+        // -------
+
+        /**
+         * O(1) in space
+         * O(budget) in time
+         * one slice of a sliding compaction: from where the last slice
+         * stopped, slides each in-use block down over the free block in
+         * front of it, so free space gathers behind the live blocks and
+         * merges; calls moved(from, to) for every block moved, whose old
+         * payload must no longer be used
+         * each block visited costs its two sentinels of budget and each
+         * block moved its payload too; stops once budget is spent, or at
+         * the end of the arena, where the next slice starts over
+         * returns whether a pass ended; for arenas every one of whose
+         * blocks is reached through something moved can update, such as
+         * HandleAllocator's handles; a no-op at check_debug
+         */
+        template <typename Fn>
+        bool compact (size_type budget, Fn moved) {
+            if(C == check_debug)
+              return true;
+            size_type i=ctl().sweep;
+            size_type spent=0;
+            while(i < size() && spent < budget) {
+              const difference_type v=sentinel(i);
+              spent+=2 * sntl_size;
+              if(v < 0) {
+                const size_type j=slide(i);
+                if(j != i) {
+                  spent+=-v;
+                  moved(reinterpret_cast<pointer>(&a[i + sntl_size]), reinterpret_cast<pointer>(&a[j + sntl_size]));
+                  i=j;
+                }
+              }
+              i+=(size_type)(v < 0 ? -v : v) + (2 * sntl_size);
+              ctl().sweep=(i < size()) ? i : 0;
+            }
+            check_all();
+            return i >= size();}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * with stats_on, O(length of the largest class's list) in time:
+         * the counters are kept as the arena changes, and only
+         * largest_free is looked up
+         * with stats_off, O(n) in time: the gauges come from a walk and
+         * the counters read 0
+         */
+        allocator_stats stats () const {
+            allocator_stats r=ctl().st;
+            r.largest_free=0;
+            if(S == stats_off) {
+              walk([&r] (const void*, size_type s, bool in_use) {
+                if(in_use)
+                  ++r.used_blocks;
+                else {
+                  ++r.free_blocks;
+                  r.bytes_free+=s;
+                  if(s > r.largest_free)
+                    r.largest_free=s;
+                }});
+            }
+            else if(ctl().nonempty != 0) {
+              const size_type c=sizeof(unsigned long) * 8 - 1 - __builtin_clzl(ctl().nonempty);
+              for(difference_type j=ctl().heads[c]; j != nil; j=link(j, 1))
+                if((size_type)sentinel(j) > r.largest_free)
+                  r.largest_free=sentinel(j);
+            }
+            r.bytes_used=size() - r.bytes_free - (2 * sntl_size) * (r.used_blocks + r.free_blocks);
+            return r;}
+
+        // ----
+        // walk
+        // ----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * calls f(payload, bytes, in_use) for every block in address
+         * order; payload points into the arena, nothing is copied
+         */
+        template <typename Fn>
+        void walk (Fn f) const {
+            size_type i=0;
+            while(i < size()) {
+              const difference_type v=sentinel(i);
+              const size_type s=v < 0 ? -v : v;
+              f(static_cast<const void*>(&a[i + sntl_size]), s, v < 0);
+              i+=s + (2 * sntl_size);
+            }}
+
+        // ---------
+        // histogram
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * fills used[0..hist_bins) and free[0..hist_bins): bin b counts the
+         * in-use or free blocks whose payload is in [2^b, 2^(b+1))
+         */
+        void histogram (size_type* used, size_type* free) const {
+            std::fill(used, used + hist_bins, 0);
+            std::fill(free, free + hist_bins, 0);
+            walk([used, free] (const void*, size_type s, bool in_use) {
+              const size_type b=sizeof(unsigned long) * 8 - 1 - __builtin_clzl(s);
+              ++(in_use ? used : free)[b];});}
+
+        // ------
+        // in_use
+        // ------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether p is the payload of an in-use block, judged only by that
+         * block's own header and footer
+         * reads the arena like any other call: another thread must not
+         * allocate or free in it meanwhile, since if p is not in use, its
+         * header may be rewritten by a split or a coalesce as it is read
+         */
+        bool in_use (const_pointer p) const {
+            const char* const q=reinterpret_cast<const char*>(p);
+            if(q < a + sntl_size + front_rz || q >= a + size())
+              return false;
+            const size_type i=q - a - sntl_size - front_rz;
+            const difference_type v=sentinel(i);
+            return v < 0 && (size_type)-v <= size() - i - (2 * sntl_size) && sentinel(i + sntl_size - v) == v;}
 
         // -------
         // isValid
         // -------
-        
+
         /**
          * calls valid
          */
-        bool isValid() {
+        bool isValid() const {
           return valid();}
 
         // -------
@@ -288,14 +1600,42 @@ class Allocator {
          */
         void destroy (pointer p) {
             p->~T(); // this is correct
-            assert(valid());}
+            check_all();}
+
+        // ----
+        // view
+        // ----
 
         /**
          * O(1) in space
          * O(1) in time
-         * <your documentation>
+         * returns the full-width sentinel at a[i]
+         */
+        difference_type view (size_type i) const {
+            return sentinel(i);}
+
+        // ----
+        // owns
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether p points into this arena
+         */
+        bool owns (const void* p) const {
+            return static_cast<const char*>(p) >= a && static_cast<const char*>(p) < a + size();}
+
+        // -----
+        // empty
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether nothing is allocated, i.e. the arena is one free block
          */
-        const int& view (int i) const {
-            return *reinterpret_cast<const int*>(&a[i]);}};
+        bool empty () const {
+            return sentinel(0) == (difference_type)(size() - (2 * sntl_size));}};
 
 #endif // Allocator_h
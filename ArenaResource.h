@@ -0,0 +1,300 @@
+// ----------------------------------
+// projects/allocator/ArenaResource.h
+// ----------------------------------
+
+#ifndef ArenaResource_h
+#define ArenaResource_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef>         // max_align_t, ptrdiff_t, size_t
+#include <limits>          // numeric_limits
+#include <memory_resource> // memory_resource
+#include <new>             // bad_array_new_length, new
+
+#include "Allocator.h"
+
+// -------------
+// ArenaResource
+// -------------
+
+/**
+ * a std::pmr::memory_resource over one boundary-tag arena, an
+ * Allocator<char, N, C, F, S>; N == 0 takes a runtime-sized buffer
+ * std::pmr containers reach it through the virtual do_allocate;
+ * ArenaAllocator reaches it through the non-virtual allocate_bytes
+ * and deallocate_bytes, which the virtual functions forward to
+ * not copyable: containers hold its address
+ */
+template <int N, check_level C = check_local, fit_policy F = first_fit, stats_mode S = stats_on>
+class ArenaResource final : public std::pmr::memory_resource {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef std::size_t size_type;
+
+        typedef Allocator<char, N, C, F, S> arena_type;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        arena_type x;
+
+    protected:
+        // -----------
+        // do_allocate
+        // -----------
+
+        void* do_allocate (size_type bytes, size_type al) override {
+            return allocate_bytes(bytes, al);}
+
+        // -------------
+        // do_deallocate
+        // -------------
+
+        void do_deallocate (void* p, size_type bytes, size_type al) override {
+            deallocate_bytes(p, bytes, al);}
+
+        // -----------
+        // do_is_equal
+        // -----------
+
+        /**
+         * memory from one arena can only go back to that arena
+         */
+        bool do_is_equal (const std::pmr::memory_resource& that) const noexcept override {
+            return this == &that;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        ArenaResource () :
+                x() {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, over the caller's buffer; see Allocator
+         */
+        ArenaResource (void* p, size_type bytes) :
+                x(p, bytes) {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, over an anonymous mmap region; see Allocator
+         */
+        explicit ArenaResource (size_type bytes, bool huge = false) :
+                x(bytes, huge) {}
+
+        ArenaResource (const ArenaResource&) = delete;
+        ArenaResource& operator = (const ArenaResource&) = delete;
+
+        // --------------
+        // allocate_bytes
+        // --------------
+
+        /**
+         * O(1) in space
+         * same time as Allocator::allocate_aligned
+         * bytes bytes on an al-byte boundary, al a power of two
+         * throws bad_alloc if the arena has no room
+         */
+        void* allocate_bytes (size_type bytes, size_type al = alignof(std::max_align_t)) {
+            return x.allocate_aligned(bytes == 0 ? 1 : bytes, al);}
+
+        // ----------------
+        // deallocate_bytes
+        // ----------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void deallocate_bytes (void* p, size_type bytes, size_type = alignof(std::max_align_t)) {
+            x.deallocate(static_cast<char*>(p), bytes);}
+
+        // -----
+        // arena
+        // -----
+
+        /**
+         * the arena, for stats() and isValid()
+         */
+        const arena_type& arena () const {
+            return x;}};
+
+// --------------
+// ArenaAllocator
+// --------------
+
+/**
+ * a typed facade over a resource R such as ArenaResource<N>, which it
+ * holds by address and calls without going through a vtable
+ * rebinds to any U over the same resource, so a std::list, std::map or
+ * std::unordered_map, and any number of containers of different element
+ * types, share one arena
+ */
+template <typename T, typename R = ArenaResource<0> >
+class ArenaAllocator {
+    template <typename, typename>
+    friend class ArenaAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        typedef R resource_type;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef ArenaAllocator<U, R> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const ArenaAllocator& lhs, const ArenaAllocator& rhs) {
+            return lhs.r == rhs.r;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const ArenaAllocator& lhs, const ArenaAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        R* r;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * r must outlive every copy
+         */
+        explicit ArenaAllocator (R& r) :
+                r(&r) {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a rebound copy shares the resource
+         */
+        template <typename U>
+        ArenaAllocator (const ArenaAllocator<U, R>& that) :
+                r(that.r) {}
+
+        // Default copy, destructor, and copy assignment
+        // ArenaAllocator (const ArenaAllocator&);
+        // ~ArenaAllocator ();
+        // ArenaAllocator& operator = (const ArenaAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * same time as R::allocate_bytes
+         * throws bad_array_new_length if n * sizeof(T) would overflow
+         */
+        pointer allocate (size_type n) {
+            if (n > max_size())
+                throw std::bad_array_new_length();
+            return static_cast<pointer>(r->allocate_bytes(n * sizeof(T), alignof(T)));}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * same time as R::deallocate_bytes
+         * throws bad_array_new_length if n * sizeof(T) would overflow,
+         * as no allocate could have returned p for such an n
+         */
+        void deallocate (pointer p, size_type n) {
+            if (n > max_size())
+                throw std::bad_array_new_length();
+            r->deallocate_bytes(p, n * sizeof(T), alignof(T));}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // --------
+        // max_size
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the largest n whose n * sizeof(T) bytes fit a size_type
+         */
+        size_type max_size () const {
+            return std::numeric_limits<size_type>::max() / sizeof(T);}
+
+        // --------
+        // resource
+        // --------
+
+        R* resource () const {
+            return r;}};
+
+#endif // ArenaResource_h
@@ -0,0 +1,1078 @@
+// -------------------------------------
+// projects/allocator/BenchAllocator.c++
+// -------------------------------------
+
+/*
+To run the benchmark:
+    % g++ -pedantic -std=c++17 -Wall -O2 -DNDEBUG BenchAllocator.c++ -o BenchAllocator -lpthread
+
+    % ./BenchAllocator > BenchAllocator.out
+
+Every line after the header is one CSV row:
+    bench,allocator,type,arena,param,ops,ns_per_op,p50_ns,p99_ns,p999_ns,peak_frag
+an op is one allocate or deallocate call (one push_back or pop for the
+container benches); fields that do not apply are left empty
+peak_frag is the highest 1 - largest free block / free bytes seen; the
+locality rows put there instead the share of blocks whose page sits on
+the allocating thread's NUMA node
+*/
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // max, nth_element, swap
+#include <atomic>    // atomic
+#include <chrono>    // steady_clock
+#include <iostream>  // cout
+#include <list>      // list
+#include <map>       // map
+#include <memory_resource> // polymorphic_allocator
+#include <memory>    // allocator
+#include <mutex>     // lock_guard, mutex
+#include <new>       // bad_alloc
+#include <string>    // string
+#include <thread>    // thread
+#include <vector>    // vector
+
+#include "Allocator.h"
+#include "CachingAllocator.h"
+#include "PoolAllocator.h"
+#include "GrowableAllocator.h"
+#include "MonotonicAllocator.h"
+#include "ArenaResource.h"
+#include "BitmapAllocator.h"
+#include "HandleAllocator.h"
+#include "SmallAllocator.h"
+#include "ShardedAllocator.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// ------
+// Locked
+// ------
+
+/**
+ * the old way of sharing one Allocator: every call takes a global mutex
+ */
+template <typename A>
+struct Locked {
+    typedef typename A::value_type value_type;
+    typedef typename A::pointer    pointer;
+    typedef typename A::size_type  size_type;
+
+    std::mutex m;
+    A          x;
+
+    pointer allocate (size_type n) {
+        std::lock_guard<std::mutex> g(m);
+        return x.allocate(n);}
+
+    void deallocate (pointer p, size_type n) {
+        std::lock_guard<std::mutex> g(m);
+        x.deallocate(p, n);}};
+
+// ----
+// name
+// ----
+
+template <typename T>
+std::string name (const std::allocator<T>*) {
+    return "std::allocator";}
+
+template <typename T, int N, check_level C, fit_policy F, stats_mode S>
+std::string name (const Allocator<T, N, C, F, S>*) {
+    return std::string("Allocator")
+        + (N == 0          ? "/runtime" : "")
+        + (C == check_none ? "/check_none" : C == check_local ? "" : C == check_full ? "/check_full" : "/check_debug")
+        + (F == first_fit  ? "" : F == next_fit ? "/next_fit" : "/best_fit")
+        + (S == stats_on   ? "" : "/stats_off");}
+
+template <typename T, int N>
+std::string name (const CachingAllocator<T, N>*) {
+    return "CachingAllocator";}
+
+template <typename T, int N>
+std::string name (const PoolAllocator<T, N>*) {
+    return "PoolAllocator";}
+
+template <typename T, check_level C, fit_policy F, stats_mode S>
+std::string name (const GrowableAllocator<T, C, F, S>*) {
+    return "GrowableAllocator";}
+
+template <typename T, int N>
+std::string name (const MonotonicAllocator<T, N>*) {
+    return "MonotonicAllocator";}
+
+template <typename T, int N, check_level C>
+std::string name (const SmallAllocator<T, N, C>*) {
+    return std::string("SmallAllocator")
+        + (C == check_none ? "/check_none" : C == check_local ? "" : "/check_full");}
+
+template <typename T, int N, check_level C>
+std::string name (const BitmapAllocator<T, N, C>*) {
+    return std::string("BitmapAllocator")
+        + (C == check_none ? "/check_none" : C == check_local ? "" : "/check_full");}
+
+template <typename T, check_level C, fit_policy F, stats_mode S>
+std::string name (const ShardedAllocator<T, C, F, S>*) {
+    return "ShardedAllocator";}
+
+template <typename A>
+std::string name (const Locked<A>*) {
+    return "Locked<" + name(static_cast<const A*>(0)) + ">";}
+
+inline std::string type_name (const int*) {
+    return "int";}
+
+inline std::string type_name (const double*) {
+    return "double";}
+
+// -------------
+// fragmentation
+// -------------
+
+/**
+ * 1 - largest free block / free bytes, or -1 where the heap is opaque
+ */
+template <typename T>
+double fragmentation (const std::allocator<T>&) {
+    return -1;}
+
+/**
+ * reads the gauges from stats()
+ */
+template <typename T, int N, check_level C, fit_policy F, stats_mode S>
+double fragmentation (const Allocator<T, N, C, F, S>& x) {
+    const allocator_stats s = x.stats();
+    return s.bytes_free == 0 ? 0 : 1 - double(s.largest_free) / s.bytes_free;}
+
+/**
+ * over all chunks, against the largest free block in any one
+ */
+template <typename T, check_level C, fit_policy F, stats_mode S>
+double fragmentation (const GrowableAllocator<T, C, F, S>& x) {
+    const allocator_stats s = x.stats();
+    return s.bytes_free == 0 ? 0 : 1 - double(s.largest_free) / s.bytes_free;}
+
+/**
+ * reads the gauges from the handle arena's stats()
+ */
+template <typename T, int N, check_level C, fit_policy F, stats_mode S>
+double fragmentation (const HandleAllocator<T, N, C, F, S>& x) {
+    const allocator_stats s = x.stats();
+    return s.bytes_free == 0 ? 0 : 1 - double(s.largest_free) / s.bytes_free;}
+
+/**
+ * reads the gauges from stats(), which counts the free runs in the mask
+ */
+template <typename T, int N, check_level C>
+double fragmentation (const SmallAllocator<T, N, C>& x) {
+    const allocator_stats s = x.stats();
+    return s.bytes_free == 0 ? 0 : 1 - double(s.largest_free) / s.bytes_free;}
+
+/**
+ * reads the gauges from stats(), which counts the free runs in the bitmap
+ */
+template <typename T, int N, check_level C>
+double fragmentation (const BitmapAllocator<T, N, C>& x) {
+    const allocator_stats s = x.stats();
+    return s.bytes_free == 0 ? 0 : 1 - double(s.largest_free) / s.bytes_free;}
+
+// -----
+// Probe
+// -----
+
+/**
+ * runs each op of a workload; when timed, also records its latency
+ * and every 16 ops samples the fragmentation of x (unless x is null)
+ */
+template <typename A>
+class Probe {
+    private:
+        const A*            x;
+        bool                timed;
+        long                n;
+        std::vector<double> lat;
+        double              peak;
+
+    public:
+        Probe (const A* x, bool timed) :
+                x     (x),
+                timed (timed),
+                n     (0),
+                peak  (-1) {}
+
+        template <typename F>
+        void operator () (F f) {
+            ++n;
+            if (!timed) {
+                f();
+                return;}
+            const bench_clock::time_point b = bench_clock::now();
+            f();
+            const bench_clock::time_point e = bench_clock::now();
+            lat.push_back(std::chrono::duration<double, std::nano>(e - b).count());
+            if (x != 0 && n % 16 == 0)
+                peak = std::max(peak, fragmentation(*x));}
+
+        long ops () const {
+            return n;}
+
+        double peak_frag () const {
+            return peak;}
+
+        /**
+         * the q-quantile of the recorded latencies, q in [0, 1)
+         */
+        double quantile (double q) {
+            if (lat.empty())
+                return -1;
+            std::vector<double>::iterator k = lat.begin() + static_cast<long>(q * lat.size());
+            std::nth_element(lat.begin(), k, lat.end());
+            return *k;}};
+
+// ---
+// lcg
+// ---
+
+/**
+ * the benches' fixed random sequence
+ */
+inline unsigned lcg (unsigned& r) {
+    r = r * 1103515245 + 12345;
+    return r >> 8;}
+
+// ---------
+// workloads
+// ---------
+
+/**
+ * each workload sizes itself to about half of a bytes-sized arena
+ * and repeats until it has run at least target_ops ops
+ */
+const long target_ops = 200000;
+
+template <typename A>
+std::size_t objects (int bytes) {
+    return bytes / (2 * (4 * sizeof(typename A::value_type) + 2 * sizeof(std::size_t)));}
+
+/**
+ * allocate k blocks of 4 elements, free them newest first
+ */
+template <typename A>
+void lifo (A& x, Probe<A>& r, int bytes) {
+    typedef typename A::pointer pointer;
+    std::vector<pointer> p(objects<A>(bytes));
+    while (r.ops() < target_ops) {
+        for (std::size_t i = 0; i != p.size(); ++i)
+            r([&] () {p[i] = x.allocate(4);});
+        for (std::size_t i = p.size(); i != 0; --i)
+            r([&] () {x.deallocate(p[i - 1], 4);});}}
+
+/**
+ * allocate k blocks of 4 elements, free them oldest first
+ */
+template <typename A>
+void fifo (A& x, Probe<A>& r, int bytes) {
+    typedef typename A::pointer pointer;
+    std::vector<pointer> p(objects<A>(bytes));
+    while (r.ops() < target_ops) {
+        for (std::size_t i = 0; i != p.size(); ++i)
+            r([&] () {p[i] = x.allocate(4);});
+        for (std::size_t i = 0; i != p.size(); ++i)
+            r([&] () {x.deallocate(p[i], 4);});}}
+
+/**
+ * allocate k blocks of 4 elements, free them in a shuffled order
+ */
+template <typename A>
+void random_order (A& x, Probe<A>& r, int bytes) {
+    typedef typename A::pointer pointer;
+    std::vector<pointer> p(objects<A>(bytes));
+    unsigned s = 12345;
+    while (r.ops() < target_ops) {
+        for (std::size_t i = 0; i != p.size(); ++i)
+            r([&] () {p[i] = x.allocate(4);});
+        for (std::size_t i = p.size(); i > 1; --i)
+            std::swap(p[i - 1], p[lcg(s) % i]);
+        for (std::size_t i = 0; i != p.size(); ++i)
+            r([&] () {x.deallocate(p[i], 4);});}}
+
+/**
+ * random churn over k / 4 slots: an empty slot gets 1 to 16 elements,
+ * a full one is freed; requests the arena cannot place are skipped
+ */
+template <typename A>
+void mixed (A& x, Probe<A>& r, int bytes) {
+    typedef typename A::pointer pointer;
+    std::vector<pointer>     p(objects<A>(bytes) / 4, pointer(0));
+    std::vector<std::size_t> n(p.size(), 0);
+    unsigned s = 12345;
+    while (r.ops() < target_ops) {
+        const std::size_t k = lcg(s) % p.size();
+        if (p[k] == 0) {
+            n[k] = 1 + lcg(s) % 16;
+            try {
+                r([&] () {p[k] = x.allocate(n[k]);});}
+            catch (std::bad_alloc&) {}}
+        else {
+            r([&] () {x.deallocate(p[k], n[k]);});
+            p[k] = 0;}}
+    for (std::size_t k = 0; k != p.size(); ++k)
+        if (p[k] != 0)
+            x.deallocate(p[k], n[k]);}
+
+/**
+ * push_back into a std::vector until it holds a quarter of the arena
+ */
+template <typename A>
+void vector_growth (A& x, Probe<A>& r, int bytes) {
+    typedef typename A::value_type value_type;
+    const long m = bytes / (4 * sizeof(value_type));
+    while (r.ops() < target_ops) {
+        std::vector<value_type, A>* const v = new std::vector<value_type, A>(x);
+        for (long i = 0; i != m; ++i)
+            r([&] () {v->push_back(value_type(i));});
+        delete v;}}
+
+/**
+ * push_back nodes onto a std::list, then pop them all from the front
+ */
+template <typename A>
+void list_growth (A& x, Probe<A>& r, int bytes) {
+    typedef typename A::value_type value_type;
+    const long m = bytes / 128;
+    while (r.ops() < target_ops) {
+        std::list<value_type, A>* const l = new std::list<value_type, A>(x);
+        for (long i = 0; i != m; ++i)
+            r([&] () {l->push_back(value_type(i));});
+        for (long i = 0; i != m; ++i)
+            r([&] () {l->pop_front();});
+        delete l;}}
+
+// ----
+// emit
+// ----
+
+/**
+ * prints one CSV row; negative arena, param, latency or fragmentation
+ * values are printed as empty fields
+ */
+void emit (const std::string& bench, const std::string& allocator, const std::string& type, long arena, long param,
+           long ops, double ns_per_op, double p50, double p99, double p999, double peak_frag) {
+    using namespace std;
+    cout << bench << "," << allocator << "," << type << ",";
+    if (arena >= 0)
+        cout << arena;
+    cout << ",";
+    if (param >= 0)
+        cout << param;
+    cout << "," << ops << "," << ns_per_op << ",";
+    if (p50 >= 0)
+        cout << p50 << "," << p99 << "," << p999;
+    else
+        cout << ",,";
+    cout << ",";
+    if (peak_frag >= 0)
+        cout << peak_frag;
+    cout << endl;}
+
+// ---
+// run
+// ---
+
+/**
+ * runs workload w on a fresh A twice: untimed per op for ns/op, then
+ * timed per op for the latency quantiles and peak fragmentation
+ * container workloads pass opaque, as the container holds its own
+ * copy of the allocator
+ */
+template <typename A>
+void run (const std::string& bench, void (*w)(A&, Probe<A>&, int), int bytes, bool opaque = false) {
+    A* x = new A;
+    Probe<A> bulk(0, false);
+    const bench_clock::time_point b = bench_clock::now();
+    w(*x, bulk, bytes);
+    const bench_clock::time_point e = bench_clock::now();
+    delete x;
+
+    x = new A;
+    Probe<A> timed(opaque ? 0 : x, true);
+    w(*x, timed, bytes);
+    delete x;
+
+    emit(bench, name(static_cast<const A*>(0)), type_name(static_cast<const typename A::value_type*>(0)), bytes, -1,
+         bulk.ops(), std::chrono::duration<double, std::nano>(e - b).count() / bulk.ops(),
+         timed.quantile(0.5), timed.quantile(0.99), timed.quantile(0.999), timed.peak_frag());}
+
+// -----
+// suite
+// -----
+
+/**
+ * every standard workload for std::allocator<T> and Allocator<T, N>
+ */
+template <typename T, int N>
+void suite () {
+    typedef std::allocator<T> S;
+    typedef Allocator<T, N>   A;
+    run<S>("lifo",   &lifo<S>,          N);
+    run<A>("lifo",   &lifo<A>,          N);
+    run<S>("fifo",   &fifo<S>,          N);
+    run<A>("fifo",   &fifo<A>,          N);
+    run<S>("random", &random_order<S>,  N);
+    run<A>("random", &random_order<A>,  N);
+    run<S>("mixed",  &mixed<S>,         N);
+    run<A>("mixed",  &mixed<A>,         N);
+    run<S>("vector", &vector_growth<S>, N, true);
+    run<A>("vector", &vector_growth<A>, N, true);
+    run<S>("list",   &list_growth<S>,   N, true);
+    run<A>("list",   &list_growth<A>,   N, true);}
+
+// ------
+// growth
+// ------
+
+/**
+ * the standard workloads sized for N bytes on a GrowableAllocator<T>,
+ * whose 64 KiB first chunk has to grow when N is larger
+ */
+template <typename T, int N>
+void growth () {
+    typedef GrowableAllocator<T> G;
+    run<G>("lifo",   &lifo<G>,          N);
+    run<G>("fifo",   &fifo<G>,          N);
+    run<G>("random", &random_order<G>,  N);
+    run<G>("mixed",  &mixed<G>,         N);
+    run<G>("vector", &vector_growth<G>, N, true);
+    run<G>("list",   &list_growth<G>,   N, true);}
+
+// ----------
+// fragmented
+// ----------
+
+/**
+ * allocates 2 * k single ints, frees every other one so the arena
+ * holds k small free fragments in front of one large free block,
+ * then times allocate/deallocate pairs that only the large block fits
+ */
+template <int N, typename A = Allocator<int, N> >
+void fragmented (int k, int reps) {
+    A* const x = new A;
+    std::vector<int*> p(2 * k);
+    for (int i = 0; i != 2 * k; ++i)
+        p[i] = x->allocate(1);
+    for (int i = 0; i < 2 * k; i += 2)
+        x->deallocate(p[i], 1);
+
+    const bench_clock::time_point b = bench_clock::now();
+    for (int i = 0; i != reps; ++i) {
+        int* const q = x->allocate(64);
+        x->deallocate(q, 64);}
+    const bench_clock::time_point e = bench_clock::now();
+
+    emit("scan", name(x), "int", N, k, 2L * reps,
+         std::chrono::duration<double, std::nano>(e - b).count() / (2.0 * reps), -1, -1, -1, fragmentation(*x));
+    delete x;}
+
+// ------
+// layout
+// ------
+
+/**
+ * fills a fresh A with single elements until it runs out, then checks
+ * the full arena reps times; param is the number of blocks that fit,
+ * so N / param - sizeof(T) is the metadata and padding per block
+ */
+template <typename A, int N>
+void fill (int reps) {
+    typedef typename A::value_type value_type;
+    A* const x = new A;
+    long n = 0;
+    const bench_clock::time_point b = bench_clock::now();
+    try {
+        for (;; ++n)
+            x->allocate(1);}
+    catch (std::bad_alloc&) {}
+    const bench_clock::time_point e = bench_clock::now();
+    emit("fill", name(x), type_name(static_cast<const value_type*>(0)), N, n, n,
+         std::chrono::duration<double, std::nano>(e - b).count() / n, -1, -1, -1, -1);
+
+    bool ok = true;
+    const bench_clock::time_point c = bench_clock::now();
+    for (int i = 0; i != reps; ++i)
+        ok = x->isValid() && ok;
+    const bench_clock::time_point f = bench_clock::now();
+    emit("valid", name(x), type_name(static_cast<const value_type*>(0)), N, n, ok ? reps : -reps,
+         std::chrono::duration<double, std::nano>(f - c).count() / reps, -1, -1, -1, -1);
+    delete x;}
+
+/**
+ * the sentinel layout against the side bitmap for T on an N-byte arena:
+ * how many single elements fit, how long a full check takes, and the
+ * mixed workload
+ */
+template <typename T, int N>
+void layout () {
+    typedef Allocator<T, N>       A;
+    typedef BitmapAllocator<T, N> B;
+    fill<A, N>(20);
+    fill<B, N>(20);
+    run<A>("mixed", &mixed<A>, N);
+    run<B>("mixed", &mixed<B>, N);}
+
+// -----
+// small
+// -----
+
+/**
+ * the standard workloads on an N-byte arena of a few KiB: the sentinel
+ * layout against one occupancy mask, with and without checks
+ */
+template <int N>
+void small () {
+    typedef Allocator<int, N>                  A;
+    typedef SmallAllocator<int, N>             B;
+    typedef SmallAllocator<int, N, check_none> D;
+    run<A>("lifo",   &lifo<A>,         N);
+    run<B>("lifo",   &lifo<B>,         N);
+    run<D>("lifo",   &lifo<D>,         N);
+    run<A>("random", &random_order<A>, N);
+    run<B>("random", &random_order<B>, N);
+    run<D>("random", &random_order<D>, N);
+    run<A>("mixed",  &mixed<A>,        N);
+    run<B>("mixed",  &mixed<B>,        N);
+    run<D>("mixed",  &mixed<D>,        N);}
+
+// ----
+// free
+// ----
+
+/**
+ * fills a fresh arena with single ints and frees them in two passes:
+ * every other block first, whose neighbours are both in use, then the
+ * rest, each merging with a free block on either side
+ * returns the ns per deallocate of the pass selected by odd
+ */
+template <typename A>
+double free_pass (A& x, Probe<A>& probe, bool odd) {
+    std::vector<int*> p;
+    try {
+        for (;;)
+            p.push_back(x.allocate(1));}
+    catch (std::bad_alloc&) {}
+    bench_clock::time_point b;
+    for (int k = 0; k != 2; ++k) {
+        if (k == int(odd))
+            b = bench_clock::now();
+        for (std::size_t i = k; i < p.size(); i += 2) {
+            int* const q = p[i];
+            if (k == int(odd))
+                probe([&] {x.deallocate(q, 1);});
+            else
+                x.deallocate(q, 1);}
+        if (k == int(odd))
+            return std::chrono::duration<double, std::nano>(bench_clock::now() - b).count() / probe.ops();}
+    return 0;}
+
+/**
+ * deallocate latency on an N-byte arena at check level C, without and
+ * with coalescing; flat numbers across N show the O(1) free path
+ */
+template <int N, check_level C>
+void free_latency () {
+    typedef Allocator<int, N, C> A;
+    for (int odd = 0; odd != 2; ++odd) {
+        A* x = new A;
+        Probe<A> bulk(0, false);
+        const double ns = free_pass(*x, bulk, odd);
+        delete x;
+        x = new A;
+        Probe<A> timed(0, true);
+        free_pass(*x, timed, odd);
+        delete x;
+        emit(odd ? "free_coalesce" : "free_isolated", name(x), "int", N, -1, bulk.ops(), ns,
+             timed.quantile(0.5), timed.quantile(0.99), timed.quantile(0.999), -1);}}
+
+// -----
+// level
+// -----
+
+/**
+ * the mixed workload on a 64 KiB arena at check level C
+ */
+template <check_level C>
+void level () {
+    typedef Allocator<int, (1 << 16), C> A;
+    run<A>("mixed", &mixed<A>, 1 << 16);}
+
+// ------
+// expand
+// ------
+
+/**
+ * m buffers of ints grown round-robin 16 elements at a time up to cap
+ * elements each, then freed, reps times on one 4 MiB arena; with
+ * in_place, try_expand is tried before allocate, copy and deallocate
+ * ns per growth step, with the peak fragmentation seen at the step
+ * before the buffers are freed
+ */
+void expand (int m, int cap, int reps, bool in_place) {
+    typedef Allocator<int, (1 << 22)> A;
+    A* const x = new A;
+    std::vector<int*> p(m);
+    std::vector<int>  n(m);
+    double peak = 0;
+    long   steps = 0;
+    const bench_clock::time_point b = bench_clock::now();
+    for (int k = 0; k != reps; ++k) {
+        for (int i = 0; i != m; ++i) {
+            n[i] = 16;
+            p[i] = x->allocate(16);}
+        for (int g = 16; g < cap; g += 16)
+            for (int i = 0; i != m; ++i, ++steps) {
+                if (in_place && x->try_expand(p[i], n[i], n[i] + 16)) {
+                    n[i] += 16;
+                    continue;}
+                int* const q = x->allocate(n[i] + 16);
+                std::copy(p[i], p[i] + n[i], q);
+                x->deallocate(p[i], n[i]);
+                p[i] = q;
+                n[i] += 16;}
+        if (k == 0)
+            peak = fragmentation(*x);
+        for (int i = 0; i != m; ++i)
+            x->deallocate(p[i], n[i]);}
+    const bench_clock::time_point e = bench_clock::now();
+    delete x;
+    emit(in_place ? "expand" : "expand_copy", "Allocator", "int", 1 << 22, m, steps,
+         std::chrono::duration<double, std::nano>(e - b).count() / steps, -1, -1, -1, peak);}
+
+// -------
+// compact
+// -------
+
+/**
+ * fills a 4 MiB handle arena with blocks of 1 to 64 ints, frees a
+ * random half, then compacts it in slices of budget bytes until a pass
+ * ends; an op is one slice, whose latency quantiles show the bound
+ * peak_frag is the fragmentation before compacting; it is 0 after
+ */
+void compact (long budget) {
+    typedef HandleAllocator<int, (1 << 22)> A;
+    A* const x = new A;
+    std::vector<A::handle> h;
+    unsigned s = 12345;
+    try {
+        for (;;)
+            h.push_back(x->allocate(1 + lcg(s) % 64));}
+    catch (std::bad_alloc&) {}
+    for (std::size_t i = 0; i != h.size(); ++i)
+        if (lcg(s) % 2 == 0)
+            x->deallocate(h[i]);
+    const double before = fragmentation(*x);
+
+    Probe<A> probe(0, true);
+    bool done = false;
+    const bench_clock::time_point b = bench_clock::now();
+    while (!done)
+        probe([&] {done = x->compact(budget);});
+    const bench_clock::time_point e = bench_clock::now();
+    emit("compact", "HandleAllocator", "int", 1 << 22, budget, probe.ops(),
+         std::chrono::duration<double, std::nano>(e - b).count() / probe.ops(),
+         probe.quantile(0.5), probe.quantile(0.99), probe.quantile(0.999), before);
+    delete x;}
+
+// -----
+// nodes
+// -----
+
+/**
+ * reps rounds of filling a std::list and a std::map of k ints through
+ * allocator a and clearing them; ns per node
+ */
+template <typename A>
+void nodes (const std::string& allocator, const A& a, int k, int reps) {
+    typedef typename std::allocator_traits<A>::template rebind_alloc<std::pair<const int, int> > M;
+    const bench_clock::time_point b = bench_clock::now();
+    for (int i = 0; i != reps; ++i) {
+        std::list<int, A> l(a);
+        std::map<int, int, std::less<int>, M> m{M(a)};
+        for (int j = 0; j != k; ++j) {
+            l.push_back(j);
+            m[j] = j;}}
+    const bench_clock::time_point e = bench_clock::now();
+    emit("nodes", allocator, "int", -1, k, 2L * k * reps,
+         std::chrono::duration<double, std::nano>(e - b).count() / (2.0 * k * reps), -1, -1, -1, -1);}
+
+/**
+ * one ArenaResource behind the typed ArenaAllocator facade and behind
+ * std::pmr::polymorphic_allocator, whose calls go through the vtable
+ */
+void nodes (int k, int reps) {
+    typedef ArenaResource<(1 << 20)> R;
+    R* const r = new R;
+    nodes("std::allocator",             std::allocator<int>(),                      k, reps);
+    nodes("ArenaAllocator",             ArenaAllocator<int, R>(*r),                 k, reps);
+    nodes("pmr::polymorphic_allocator", std::pmr::polymorphic_allocator<int>(r),    k, reps);
+    delete r;}
+
+// -------
+// request
+// -------
+
+/**
+ * one request's worth of scratch: k allocations of 1 to 16 ints, all
+ * freed at the end, one deallocate each, or with free_all if non-null
+ */
+template <typename A>
+void request_pass (A& x, int k, void (*free_all)(A&)) {
+    static std::vector<int*> p;
+    static std::vector<int>  n;
+    p.resize(k);
+    n.resize(k);
+    unsigned r = 12345;
+    for (int i = 0; i != k; ++i) {
+        r = r * 1103515245u + 12345u;
+        n[i] = 1 + (r >> 16) % 16;
+        p[i] = x.allocate(n[i]);}
+    if (free_all != 0)
+        free_all(x);
+    else
+        for (int i = 0; i != k; ++i)
+            x.deallocate(p[i], n[i]);}
+
+template <typename A>
+void reset_all (A& x) {
+    x.reset();}
+
+/**
+ * reps requests of k allocations each on one A; ns per allocation
+ */
+template <typename A>
+void request (int k, int reps, void (*free_all)(A&) = 0) {
+    A* const x = new A;
+    const bench_clock::time_point b = bench_clock::now();
+    for (int i = 0; i != reps; ++i)
+        request_pass(*x, k, free_all);
+    const bench_clock::time_point e = bench_clock::now();
+    delete x;
+    emit(free_all != 0 ? "request_reset" : "request", name(static_cast<const A*>(0)), "int", -1, k, long(k) * reps,
+         std::chrono::duration<double, std::nano>(e - b).count() / (long(k) * reps), -1, -1, -1, -1);}
+
+// -------
+// startup
+// -------
+
+/**
+ * constructs an arena of the given size, makes one allocate/deallocate
+ * pair and destroys it, reps times; make is the construction
+ */
+template <typename A, typename M>
+void startup (const std::string& allocator, long bytes, int reps, M make) {
+    const bench_clock::time_point b = bench_clock::now();
+    for (int i = 0; i != reps; ++i) {
+        A* const x = make();
+        x->deallocate(x->allocate(1), 1);
+        delete x;}
+    const bench_clock::time_point e = bench_clock::now();
+    emit("startup", allocator, "int", bytes, -1, reps,
+         std::chrono::duration<double, std::nano>(e - b).count() / reps, -1, -1, -1, -1);}
+
+/**
+ * a fixed arena of N bytes against mmap-backed runtime arenas of N bytes
+ * and of 1 GiB
+ */
+template <int N>
+void startup () {
+    typedef Allocator<int, N> A;
+    typedef Allocator<int, 0> R;
+    startup<A>(name(static_cast<const A*>(0)), N, 1000, [] {return new A;});
+    startup<R>(name(static_cast<const R*>(0)), N, 1000, [] {return new R(N);});
+    startup<R>(name(static_cast<const R*>(0)), 1L << 30, 1000, [] {return new R(std::size_t(1) << 30);});}
+
+// --------
+// counters
+// --------
+
+/**
+ * the mixed workload on a 64 KiB arena with the stats counters on or off
+ */
+template <stats_mode S>
+void counters () {
+    typedef Allocator<int, (1 << 16), check_local, first_fit, S> A;
+    run<A>("mixed", &mixed<A>, 1 << 16);}
+
+// ------
+// policy
+// ------
+
+/**
+ * the same fifo, shuffled and mixed traces on a 64 KiB arena under
+ * fit policy F
+ */
+template <fit_policy F>
+void policy () {
+    typedef Allocator<int, (1 << 16), check_local, F> A;
+    run<A>("fifo",   &fifo<A>,         1 << 16);
+    run<A>("random", &random_order<A>, 1 << 16);
+    run<A>("mixed",  &mixed<A>,        1 << 16);}
+
+// -----
+// batch
+// -----
+
+/**
+ * k-block rounds of 4-element allocations on a 1 MiB arena, once one
+ * call at a time and once through allocate_n / deallocate_n
+ * the freed order is shuffled, so single frees coalesce one by one
+ * ops counts blocks, so ns_per_op is the per-object cost
+ */
+template <check_level C>
+void batch (int k) {
+    typedef Allocator<int, (1 << 20), C> A;
+    A* const x = new A;
+    std::vector<int*> p(k);
+    const long rounds = target_ops / (2 * k);
+    unsigned s = 12345;
+
+    bench_clock::time_point b = bench_clock::now();
+    for (long r = 0; r != rounds; ++r) {
+        for (int i = 0; i != k; ++i)
+            p[i] = x->allocate(4);
+        for (int i = k; i > 1; --i)
+            std::swap(p[i - 1], p[lcg(s) % i]);
+        for (int i = 0; i != k; ++i)
+            x->deallocate(p[i], 4);}
+    bench_clock::time_point e = bench_clock::now();
+    emit("batch", name(x) + "/single", "int", 1 << 20, k, 2 * k * rounds,
+         std::chrono::duration<double, std::nano>(e - b).count() / (2 * k * rounds), -1, -1, -1, -1);
+
+    b = bench_clock::now();
+    for (long r = 0; r != rounds; ++r) {
+        x->allocate_n(4, &p[0], k);
+        for (int i = k; i > 1; --i)
+            std::swap(p[i - 1], p[lcg(s) % i]);
+        x->deallocate_n(&p[0], 4, k);}
+    e = bench_clock::now();
+    emit("batch", name(x) + "/batch", "int", 1 << 20, k, 2 * k * rounds,
+         std::chrono::duration<double, std::nano>(e - b).count() / (2 * k * rounds), -1, -1, -1, -1);
+    delete x;}
+
+// --------
+// threaded
+// --------
+
+/**
+ * each of t threads runs reps rounds of 8 allocate(1) then 8 deallocate
+ * on one shared A
+ */
+template <typename A>
+void threaded (int t, int reps) {
+    A* const x = new A;
+    std::vector<std::thread> w;
+    const bench_clock::time_point b = bench_clock::now();
+    for (int k = 0; k != t; ++k)
+        w.push_back(std::thread([x, reps] () {
+            int* p[8];
+            for (int r = 0; r != reps; ++r) {
+                for (int i = 0; i != 8; ++i)
+                    p[i] = x->allocate(1);
+                for (int i = 0; i != 8; ++i)
+                    x->deallocate(p[i], 1);}}));
+    for (int k = 0; k != t; ++k)
+        w[k].join();
+    const bench_clock::time_point e = bench_clock::now();
+    const long ops = 16L * t * reps;
+    emit("threads", name(x), "int", 1 << 20, t, ops,
+         std::chrono::duration<double, std::nano>(e - b).count() / ops, -1, -1, -1, -1);
+    delete x;}
+
+// ---------
+// alternate
+// ---------
+
+/**
+ * one thread runs reps rounds of allocate(1) then deallocate on each of
+ * k CachingAllocators in turn, as with k live containers; past the
+ * arenas a thread caches for, every call refills a magazine
+ */
+void alternate (int k, int reps) {
+    typedef CachingAllocator<int, (1 << 20)> A;
+    std::vector<A> x(k);
+    const bench_clock::time_point b = bench_clock::now();
+    for (int r = 0; r != reps; ++r)
+        for (int i = 0; i != k; ++i)
+            x[i].deallocate(x[i].allocate(1), 1);
+    const bench_clock::time_point e = bench_clock::now();
+    const long ops = 2L * k * reps;
+    emit("alternate", name(&x[0]), "int", 1 << 20, k, ops,
+         std::chrono::duration<double, std::nano>(e - b).count() / ops, -1, -1, -1, -1);}
+
+// ------
+// remote
+// ------
+
+/**
+ * each of t threads runs reps rounds of 8 allocate(1), then, once every
+ * thread has allocated, frees the 8 blocks of the next thread: every
+ * free crosses threads, and with t > 1, shards
+ */
+template <typename A>
+void remote (const std::string& allocator, A* x, int t, int reps) {
+    std::vector<int*>        p(8 * t);
+    std::atomic<int>         arrived(0);
+    std::vector<std::thread> w;
+    const auto wait = [&arrived, t] (int phase) {                  //everyone past phase
+        ++arrived;
+        while (arrived.load() < t * phase)
+            std::this_thread::yield();};
+    const bench_clock::time_point b = bench_clock::now();
+    for (int k = 0; k != t; ++k)
+        w.push_back(std::thread([x, &p, &wait, k, t, reps] () {
+            for (int r = 0; r != reps; ++r) {
+                for (int i = 0; i != 8; ++i)
+                    p[8 * k + i] = x->allocate(1);
+                wait(2 * r + 1);
+                for (int i = 0; i != 8; ++i)
+                    x->deallocate(p[8 * ((k + 1) % t) + i], 1);
+                wait(2 * r + 2);}}));
+    for (int k = 0; k != t; ++k)
+        w[k].join();
+    const bench_clock::time_point e = bench_clock::now();
+    const long ops = 16L * t * reps;
+    emit("remote", allocator, "int", 1 << 20, t, ops,
+         std::chrono::duration<double, std::nano>(e - b).count() / ops, -1, -1, -1, -1);}
+
+// --------
+// locality
+// --------
+
+/**
+ * each of t threads allocates 256 blocks of 64 ints, writes and sums
+ * them, and frees them; ns_per_op is per block, and the last field is
+ * the share of blocks whose page is on the node of the thread that
+ * allocated it
+ * count 1 is the unsharded baseline: one arena, one node, every thread
+ */
+void locality (const std::string& allocator, shard_by by, std::size_t count, int t) {
+    typedef ShardedAllocator<int> A;
+    A x(1 << 20, by, count);
+    std::atomic<long> local(0);
+    std::atomic<long> sum(0);
+    std::vector<std::thread> w;
+    const bench_clock::time_point b = bench_clock::now();
+    for (int k = 0; k != t; ++k)
+        w.push_back(std::thread([&x, &local, &sum] () {
+            int* p[256];
+            long s = 0;
+            for (int i = 0; i != 256; ++i) {
+                p[i] = x.allocate(64);
+                for (int j = 0; j != 64; ++j)
+                    p[i][j] = j;}
+            const int node = this_node();
+            for (int i = 0; i != 256; ++i) {
+                local += (page_node(p[i]) == node);
+                for (int j = 0; j != 64; ++j)
+                    s += p[i][j];}
+            for (int i = 0; i != 256; ++i)
+                x.deallocate(p[i], 64);
+            sum += s;}));
+    for (int k = 0; k != t; ++k)
+        w[k].join();
+    const bench_clock::time_point e = bench_clock::now();
+    const long ops = 256L * t;
+    emit("locality", allocator, "int", 1 << 20, t, ops,
+         std::chrono::duration<double, std::nano>(e - b).count() / ops, -1, -1, -1, double(local) / ops);}
+
+// ----
+// main
+// ----
+
+int main () {
+    using namespace std;
+    cout << "bench,allocator,type,arena,param,ops,ns_per_op,p50_ns,p99_ns,p999_ns,peak_frag" << endl;
+
+    suite<int,    (1 << 16)>();
+    suite<int,    (1 << 20)>();
+    suite<double, (1 << 16)>();
+    suite<double, (1 << 20)>();
+
+    growth<int, (1 << 16)>();
+    growth<int, (1 << 20)>();
+
+    for (int k = 16; k <= 65536; k *= 4) {
+        fragmented<(1 << 23)>(k, 1000000);
+        fragmented<(1 << 23), BitmapAllocator<int, (1 << 23)> >(k, 20000);}
+
+    layout<int,    (1 << 16)>();
+    layout<int,    (1 << 20)>();
+    layout<double, (1 << 20)>();
+
+    small<1024>();
+    small<4096>();
+
+    level<check_none>();
+    level<check_local>();
+    level<check_full>();
+    level<check_debug>();
+
+    for (int k = 64; k <= 4096; k *= 8)
+        nodes(k, 200000 / k);
+
+    for (int m = 1; m <= 16; m *= 4) {
+        expand(m, 4096, 64 / m, false);
+        expand(m, 4096, 64 / m, true);}
+
+    for (long b = 1 << 12; b <= (1 << 20); b *= 16)
+        compact(b);
+
+    for (int k = 64; k <= 4096; k *= 8) {
+        request<std::allocator<int> >(k, 200000 / k * 10);
+        request<Allocator<int, (1 << 20)> >(k, 200000 / k * 10);
+        request<Allocator<int, (1 << 20), check_none> >(k, 200000 / k * 10);
+        request<MonotonicAllocator<int, (1 << 20)> >(k, 200000 / k * 10, &reset_all<MonotonicAllocator<int, (1 << 20)> >);}
+
+    free_latency<(1 << 16), check_local>();
+    free_latency<(1 << 20), check_local>();
+    free_latency<(1 << 24), check_local>();
+    free_latency<(1 << 16), check_none>();
+    free_latency<(1 << 24), check_none>();
+
+    startup<(1 << 16)>();
+    startup<(1 << 20)>();
+    startup<(1 << 24)>();
+
+    counters<stats_off>();
+    counters<stats_on>();
+
+    policy<first_fit>();
+    policy<next_fit>();
+    policy<best_fit>();
+
+    for (int k = 8; k <= 256; k *= 2) {
+        batch<check_local>(k);
+        batch<check_full>(k);}
+
+    for (int t = 1; t <= 16; t *= 2) {
+        threaded<Locked<Allocator<int, (1 << 20)> > >(t, 100000);
+        threaded<CachingAllocator<int, (1 << 20)> >(t, 100000);
+        threaded<PoolAllocator<int, (1 << 20)> >(t, 100000);
+        threaded<ShardedAllocator<int> >(t, 100000);}
+
+    for (int k = 1; k <= 8; k *= 2)
+        alternate(k, 1000000 / k);
+
+    for (int t = 1; t <= 16; t *= 2) {
+        Locked<Allocator<int, (1 << 20)> >* const l = new Locked<Allocator<int, (1 << 20)> >;
+        remote(name(l), l, t, 20000);
+        delete l;
+        ShardedAllocator<int> x(1 << 20, per_cpu, t);
+        remote("ShardedAllocator/" + std::to_string(t), &x, t, 20000);}
+
+    for (int t = 1; t <= 16; t *= 2) {
+        locality("ShardedAllocator/1",        per_cpu,  1, t);
+        locality("ShardedAllocator/per_cpu",  per_cpu,  0, t);
+        locality("ShardedAllocator/per_node", per_node, 0, t);}
+    return 0;}
@@ -0,0 +1,470 @@
+// ------------------------------------
+// projects/allocator/BitmapAllocator.h
+// ------------------------------------
+
+#ifndef BitmapAllocator_h
+#define BitmapAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef>   // ptrdiff_t, size_t
+#include <cstdint>   // uint64_t
+#include <new>       // bad_alloc, new
+#include <stdexcept> // logic_error
+
+#include "Allocator.h"
+
+// ---------------
+// bitmap_granules
+// ---------------
+
+/**
+ * compile-time number of S-byte granules an N-byte arena holds when
+ * every granule also costs two bits of side bitmap, kept in whole
+ * 64-bit words
+ */
+template <int N, std::size_t S>
+struct bitmap_granules {
+    static const std::size_t guess = std::size_t(N) * 8 / (S * 8 + 2);
+    static const std::size_t words = (guess + 63) / 64;
+    static const std::size_t value = (2 * words * 8 + guess * S <= std::size_t(N)) ? guess :
+                                     (2 * words * 8 >= std::size_t(N))          ? 0     : (std::size_t(N) - 2 * words * 8) / S;};
+
+// ---------------
+// BitmapAllocator
+// ---------------
+
+/**
+ * an N-byte arena with its block metadata kept out of line, in two
+ * bitmaps at the front: the payload is cut into granules of sizeof(T)
+ * bytes, one per element, with a used bit and a head bit (first
+ * granule of a block) for each; blocks carry no sentinels, so a block
+ * of n elements takes exactly n * sizeof(T) bytes plus 2n bits
+ * allocate is first fit by address, found a 64-bit word at a time with
+ * shifts, ctz and clz, starting at the lowest word with a free bit;
+ * isValid and stats read the words with popcount, never the payload
+ * checks at check_level C, like Allocator; there is no coalescing to
+ * do, as adjacent free granules are simply adjacent zero bits
+ */
+template <typename T, int N, check_level C = check_local>
+class BitmapAllocator {
+    template <typename, int, check_level>
+    friend class BitmapAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        typedef std::uint64_t word;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef BitmapAllocator<U, N, C> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const BitmapAllocator& lhs, const BitmapAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const BitmapAllocator& lhs, const BitmapAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ---------
+        // constants
+        // ---------
+
+        const static size_type bits= 64;
+        const static size_type gran= sizeof(T);
+        const static size_type g= bitmap_granules<N, gran>::value; //granules
+        const static size_type w= (g + bits - 1) / bits;           //words per bitmap
+        const static word      full= ~word(0);
+
+        // ----
+        // data
+        // ----
+
+        word used[w];       //bit i set iff granule i is in use, or past the last granule
+        word head[w];       //bit i set iff granule i starts an in-use block
+        alignas(T) char d[g * gran];
+        size_type low;      //every word below low is full
+        size_type allocs;
+        size_type frees;
+        size_type failed;
+
+        // ----
+        // mask
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * m bits from bit b of one word, b + m <= 64
+         */
+        static word mask (size_type b, size_type m) {
+            return (m == bits) ? full : (((word(1) << m) - 1) << b);}
+
+        // -----
+        // flip
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n / 64) in time
+         * sets (on) or clears the n bits of v from bit i
+         */
+        static void flip (word* v, size_type i, size_type n, bool on) {
+            while (n != 0) {
+                const size_type b = i % bits;
+                const size_type m = (n < bits - b) ? n : bits - b;
+                if (on)
+                    v[i / bits] |= mask(b, m);
+                else
+                    v[i / bits] &= ~mask(b, m);
+                i += m;
+                n -= m;}}
+
+        // ---
+        // all
+        // ---
+
+        /**
+         * O(1) in space
+         * O(n / 64) in time
+         * whether the n bits of v from bit i are all set (on) or all clear
+         */
+        static bool all (const word* v, size_type i, size_type n, bool on) {
+            while (n != 0) {
+                const size_type b = i % bits;
+                const size_type m = (n < bits - b) ? n : bits - b;
+                if ((v[i / bits] & mask(b, m)) != (on ? mask(b, m) : 0))
+                    return false;
+                i += m;
+                n -= m;}
+            return true;}
+
+        // ----
+        // runs
+        // ----
+
+        /**
+         * O(1) in space
+         * O(log k) in time
+         * bit i of the result is set iff bits i through i + k - 1 of f
+         * are all set, 0 < k < 64; runs reaching past bit 63 are left out
+         */
+        static word runs (word f, size_type k) {
+            for (size_type r = 1; r < k && f != 0; ) {
+                const size_type s = (r < k - r) ? r : k - r;
+                f &= f >> s;
+                r += s;}
+            return f;}
+
+        // ----
+        // find
+        // ----
+
+        /**
+         * O(1) in space
+         * O(w log k) in time, one word at a time from low
+         * the first granule of the lowest run of k free granules, or g
+         * carries the length of the free run that ends the previous word
+         * into the next, so a run may span any number of words
+         */
+        size_type find (size_type k) const {
+            size_type run = 0;      //free granules just below word i
+            for (size_type i = low; i != w; ++i) {
+                const word u = used[i];
+                if (u == 0) {
+                    run += bits;
+                    if (run >= k)
+                        return i * bits + bits - run;
+                    continue;}
+                if (run + __builtin_ctzll(u) >= k)
+                    return i * bits - run;
+                if (k < bits) {
+                    const word f = runs(~u, k);
+                    if (f != 0)
+                        return i * bits + __builtin_ctzll(f);}
+                run = __builtin_clzll(u);}
+            return g;}
+
+        // -----
+        // index
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * p's granule; at check_local and above, throws logic_error if
+         * p is not the start of a granule in the arena
+         */
+        size_type index (const_pointer p) const {
+            const char* const q = reinterpret_cast<const char*>(p);
+            if (C != check_none && (q < d || q >= d + g * gran || (q - d) % gran != 0))
+                throw std::logic_error("BitmapAllocator: pointer outside the arena");
+            return (q - d) / gran;}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(w) in time
+         * every head bit marks a used granule, the bits past the last
+         * granule are set, and no word below low has a free bit
+         */
+        bool valid () const {
+            for (size_type i = 0; i != w; ++i)
+                if ((head[i] & ~used[i]) != 0)
+                    return false;
+            if (g % bits != 0 && (used[w - 1] | mask(0, g % bits)) != full)
+                return false;
+            for (size_type i = 0; i != low; ++i)
+                if (used[i] != full)
+                    return false;
+            return true;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(w) in time
+         * clears both bitmaps, except the used bits past the last
+         * granule, which stay set so no search runs off the end
+         */
+        BitmapAllocator () :
+                low(0),
+                allocs(0),
+                frees(0),
+                failed(0) {
+            static_assert(N > 0 && g >= 1, "arena too small for a single granule");
+            for (size_type i = 0; i != w; ++i) {
+                used[i] = 0;
+                head[i] = 0;}
+            if (g % bits != 0)
+                used[w - 1] = ~mask(0, g % bits);}
+
+        /**
+         * O(1) in space
+         * O(w) in time
+         * a rebound copy (e.g. a std::list's node allocator) starts with
+         * its own empty arena, and compares unequal, as Allocator's does
+         */
+        template <typename U>
+        explicit BitmapAllocator (const BitmapAllocator<U, N, C>&) :
+                BitmapAllocator() {}
+
+        // Default copy, destructor, and copy assignment
+        // BitmapAllocator (const BitmapAllocator&);
+        // ~BitmapAllocator ();
+        // BitmapAllocator& operator = (const BitmapAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(w log n) in time, see find
+         * marks the lowest run of n free granules used
+         * throws bad_alloc if n is 0 or no run is long enough
+         */
+        pointer allocate (size_type n) {
+            const size_type i = (n == 0 || n > g) ? g : find(n);
+            if (i == g) {
+                ++failed;
+                throw std::bad_alloc();}
+            flip(used, i, n, true);
+            flip(head, i, 1, true);
+            while (low != w && used[low] == full)
+                ++low;
+            ++allocs;
+            if (C == check_full && !valid())
+                throw std::logic_error("BitmapAllocator: bitmap corrupted");
+            return reinterpret_cast<pointer>(d + i * gran);}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(n / 64) in time
+         * clears p's n used bits and its head bit; at check_local and
+         * above, throws logic_error unless p starts an in-use block of
+         * exactly n elements
+         */
+        void deallocate (pointer p, size_type n) {
+            const size_type i = index(p);
+            if (C != check_none) {
+                if (!all(head, i, 1, true))
+                    throw std::logic_error("BitmapAllocator: block is already free");
+                if (n == 0 || n > g - i || !all(used, i, n, true) || !all(head, i + 1, n - 1, false) ||
+                    (i + n != g && all(used, i + n, 1, true) && !all(head, i + n, 1, true)))
+                    throw std::logic_error("BitmapAllocator: size does not match the block");}
+            flip(used, i, n, false);
+            flip(head, i, 1, false);
+            if (i / bits < low)
+                low = i / bits;
+            ++frees;
+            if (C == check_full && !valid())
+                throw std::logic_error("BitmapAllocator: bitmap corrupted");}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(w) in time
+         * in-use bytes and blocks by popcount; free runs found a word at
+         * a time, a run spanning words counted once; splits and
+         * coalesces stay 0, as granules are never split or merged
+         */
+        allocator_stats stats () const {
+            allocator_stats r = allocator_stats();
+            size_type run = 0;      //free granules just below word i
+            size_type in_use = 0;
+            for (size_type i = 0; i != w; ++i) {
+                const word u = used[i];
+                in_use        += __builtin_popcountll(u);
+                r.used_blocks += __builtin_popcountll(head[i]);
+                if (u == 0) {
+                    run += bits;
+                    continue;}
+                word f = ~u;
+                size_type b = 0;    //bits of this word behind us
+                if (run != 0) {
+                    run += __builtin_ctzll(u);
+                    b    = __builtin_ctzll(u);
+                    f   &= ~mask(0, b);
+                    ++r.free_blocks;
+                    if (run > r.largest_free)
+                        r.largest_free = run;}
+                run = 0;
+                while (f != 0) {                        //runs starting in this word
+                    const size_type s = __builtin_ctzll(f);
+                    const word      t = u & ~mask(0, s);
+                    if (t == 0) {                       //reaches the top of the word
+                        run = bits - s;
+                        break;}
+                    const size_type e = __builtin_ctzll(t);
+                    ++r.free_blocks;
+                    if (e - s > r.largest_free)
+                        r.largest_free = e - s;
+                    f &= ~mask(0, e);}}
+            if (run != 0) {
+                ++r.free_blocks;
+                if (run > r.largest_free)
+                    r.largest_free = run;}
+            in_use -= w * bits - g;                     //the bits past the last granule
+            r.bytes_used   = in_use * gran;
+            r.bytes_free   = (g - in_use) * gran;
+            r.largest_free *= gran;
+            r.allocs = allocs;
+            r.frees  = frees;
+            r.failed = failed;
+            return r;}
+
+        // --------
+        // capacity
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * how many elements the arena holds
+         */
+        static size_type capacity () {
+            return g;}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * calls valid
+         */
+        bool isValid () const {
+            return valid();}
+
+        // ----
+        // owns
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether p points into this arena
+         */
+        bool owns (const void* p) const {
+            return static_cast<const char*>(p) >= d && static_cast<const char*>(p) < d + g * gran;}
+
+        // -----
+        // empty
+        // -----
+
+        /**
+         * O(1) in space
+         * O(w) in time
+         * whether nothing is allocated
+         */
+        bool empty () const {
+            for (size_type i = 0; i != w; ++i)
+                if (head[i] != 0)
+                    return false;
+            return true;}};
+
+#endif // BitmapAllocator_h
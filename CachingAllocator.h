@@ -0,0 +1,273 @@
+// -------------------------------------
+// projects/allocator/CachingAllocator.h
+// -------------------------------------
+
+#ifndef CachingAllocator_h
+#define CachingAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef> // ptrdiff_t, size_t
+#include <memory>  // shared_ptr
+#include <mutex>   // lock_guard, mutex
+#include <new>     // bad_alloc, new
+
+#include "Allocator.h"
+
+// ----------------
+// CachingAllocator
+// ----------------
+
+/**
+ * thread-caching front end over one shared Allocator<T, N>
+ * copies share the arena, which is guarded by a single mutex
+ * each thread keeps a magazine of recently freed blocks per element
+ * count up to max_n, refilled from and returned to the arena in
+ * batches, so most small allocate/deallocate calls never take the lock
+ * blocks parked in other threads' magazines are not visible to the
+ * arena, so it can report bad_alloc a little earlier than a bare
+ * Allocator of the same N
+ * a thread keeps magazines for up to ways arenas at once, so several
+ * live allocators (e.g. two containers) can be used in turn; past that,
+ * the cached arenas give their magazines back in turn
+ */
+template <typename T, int N>
+class CachingAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef CachingAllocator<U, N> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const CachingAllocator& lhs, const CachingAllocator& rhs) {
+            return lhs.s == rhs.s;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const CachingAllocator& lhs, const CachingAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ---------
+        // constants
+        // ---------
+
+        const static size_type max_n= 8;             //largest element count that is cached
+        const static size_type mag_size= 32;         //blocks per magazine
+        const static size_type batch= mag_size / 2;  //blocks moved per trip to the arena
+        const static size_type ways= 4;              //arenas a thread caches for at once
+
+        // ------
+        // shared
+        // ------
+
+        struct shared {
+            std::mutex      m;
+            Allocator<T, N> x;};
+
+        // -----
+        // cache
+        // -----
+
+        /**
+         * one thread's magazines, bound to one arena at a time
+         */
+        struct cache {
+            std::shared_ptr<shared> owner;
+            pointer                 mag[max_n][mag_size];
+            size_type               count[max_n];
+
+            cache () :
+                    count() {}
+
+            ~cache () {
+                flush();}
+
+            /**
+             * O(1) in space
+             * O(max_n * mag_size) in time
+             * returns every cached block to the owning arena
+             */
+            void flush () {
+                std::shared_ptr<shared> o;  //may be the last reference, so it must outlive the lock
+                o.swap(owner);
+                if (!o)
+                    return;
+                std::lock_guard<std::mutex> g(o->m);
+                for (size_type k = 0; k != max_n; ++k)
+                    while (count[k] != 0)
+                        o->x.deallocate(mag[k][--count[k]], k + 1);}};
+
+        // ----
+        // data
+        // ----
+
+        std::shared_ptr<shared> s;
+
+        // -----
+        // local
+        // -----
+
+        /**
+         * O(1) in space
+         * O(ways) in time, plus O(max_n * mag_size) when a thread uses
+         * more than ways arenas and one must give its cache up
+         * returns the calling thread's cache for this arena
+         */
+        cache& local () const {
+            static thread_local cache     c[ways];
+            static thread_local size_type victim = 0;
+            cache* e = 0;                                   //an unbound cache, if any
+            for (size_type i = 0; i != ways; ++i) {
+                if (c[i].owner == s)
+                    return c[i];
+                if (!c[i].owner && e == 0)
+                    e = &c[i];}
+            if (e == 0) {
+                e = &c[victim];
+                victim = (victim + 1) % ways;
+                e->flush();}
+            e->owner = s;
+            return *e;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * creates the shared arena
+         */
+        CachingAllocator () :
+                s(std::make_shared<shared>()) {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a rebound copy (e.g. a std::list's node allocator) creates its
+         * own shared arena, as an Allocator<T, N> holds one element type,
+         * and so compares unequal to that
+         */
+        template <typename U>
+        explicit CachingAllocator (const CachingAllocator<U, N>&) :
+                CachingAllocator() {}
+
+        // Default copy, destructor, and copy assignment
+        // CachingAllocator (const CachingAllocator&);
+        // ~CachingAllocator ();
+        // CachingAllocator& operator = (const CachingAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time when the magazine is non-empty,
+         * one locked batch of arena allocations otherwise
+         * requests above max_n elements go straight to the arena
+         */
+        pointer allocate (size_type n) {
+            if (n == 0 || n > max_n) {
+                std::lock_guard<std::mutex> g(s->m);
+                return s->x.allocate(n);}
+            cache& c = local();
+            const size_type k = n - 1;
+            if (c.count[k] == 0) {
+                std::lock_guard<std::mutex> g(s->m);
+                try {
+                    while (c.count[k] != batch)
+                        c.mag[k][c.count[k]++] = s->x.allocate(n);}
+                catch (std::bad_alloc&) {
+                    if (c.count[k] == 0)
+                        throw;}}
+            return c.mag[k][--c.count[k]];}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time when the magazine has room,
+         * one locked batch of arena deallocations otherwise
+         * n must be the count p was allocated with
+         */
+        void deallocate (pointer p, size_type n) {
+            if (n > max_n) {
+                std::lock_guard<std::mutex> g(s->m);
+                s->x.deallocate(p, n);
+                return;}
+            cache& c = local();
+            const size_type k = n - 1;
+            if (c.count[k] == mag_size) {
+                std::lock_guard<std::mutex> g(s->m);
+                while (c.count[k] != mag_size - batch)
+                    s->x.deallocate(c.mag[k][--c.count[k]], n);}
+            c.mag[k][c.count[k]++] = p;}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(1) in space
+         * O(N) in time
+         * checks the shared arena under the lock
+         */
+        bool isValid () const {
+            std::lock_guard<std::mutex> g(s->m);
+            return s->x.isValid();}};
+
+#endif // CachingAllocator_h
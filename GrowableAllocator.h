@@ -0,0 +1,270 @@
+// --------------------------------------
+// projects/allocator/GrowableAllocator.h
+// --------------------------------------
+
+#ifndef GrowableAllocator_h
+#define GrowableAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef>   // ptrdiff_t, size_t
+#include <memory>    // shared_ptr
+#include <new>       // bad_alloc, new
+#include <stdexcept> // logic_error
+#include <vector>    // vector
+
+#include "Allocator.h"
+
+// -----------------
+// GrowableAllocator
+// -----------------
+
+/**
+ * an Allocator that grows instead of throwing: a chain of runtime-sized
+ * Allocator<T, 0> chunks, each with its own sentinel layout, mapped on
+ * demand
+ * each new chunk is at least twice the size of the one before it, so
+ * a process whose footprint peaks at P bytes maps O(log P) chunks
+ * allocate tries the newest chunk first, then the older ones; a chunk
+ * that becomes empty is unmapped, except the newest, which is kept so
+ * an allocate/deallocate pair at the edge does not map and unmap
+ * copies share the chunks; a rebound copy starts with its own
+ */
+template <typename T, check_level C = check_local, fit_policy F = first_fit, stats_mode S = stats_on>
+class GrowableAllocator {
+    template <typename, check_level, fit_policy, stats_mode>
+    friend class GrowableAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        typedef Allocator<T, 0, C, F, S> chunk;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef GrowableAllocator<U, C, F, S> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const GrowableAllocator& lhs, const GrowableAllocator& rhs) {
+            return lhs.s == rhs.s;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const GrowableAllocator& lhs, const GrowableAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ---------
+        // constants
+        // ---------
+
+        const static size_type overhead= 4 * sizeof(size_type); //sentinels of a chunk's first block, plus slack
+
+        // ------
+        // shared
+        // ------
+
+        struct shared {
+            std::vector<chunk> chunks; //oldest first
+            size_type          next;   //bytes of the next chunk to map
+
+            explicit shared (size_type first) :
+                    chunks(), next(first) {}};
+
+        // ----
+        // data
+        // ----
+
+        std::shared_ptr<shared> s;
+
+        // ----
+        // grow
+        // ----
+
+        /**
+         * O(1) in space
+         * O(chunks) in time, plus one mmap
+         * unmaps the kept newest chunk if it is empty, as it was too small,
+         * then maps a chunk big enough for n elements, at least twice the last
+         */
+        chunk& grow (size_type n) {
+            if (!s->chunks.empty() && s->chunks.back().empty())
+                s->chunks.pop_back();
+            size_type bytes = s->next;
+            if (bytes < n * sizeof(T) + alignof(T) + overhead)
+                bytes = n * sizeof(T) + alignof(T) + overhead;
+            s->chunks.push_back(chunk(bytes));
+            s->next = 2 * bytes;
+            return s->chunks.back();}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * nothing is mapped until the first allocate; the first chunk
+         * holds at least first bytes
+         */
+        explicit GrowableAllocator (size_type first = size_type(1) << 16) :
+                s(std::make_shared<shared>(first)) {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a rebound copy (e.g. a std::list's node allocator) starts with
+         * no chunks, its first as large as that's next
+         */
+        template <typename U>
+        explicit GrowableAllocator (const GrowableAllocator<U, C, F, S>& that) :
+                s(std::make_shared<shared>(that.s->next)) {}
+
+        // Default copy, destructor, and copy assignment
+        // GrowableAllocator (const GrowableAllocator&);
+        // ~GrowableAllocator ();
+        // GrowableAllocator& operator = (const GrowableAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(chunks) Allocator::try_allocate calls in time, plus one mmap
+         * when none of them fits
+         * throws bad_alloc only if n is 0 or a new chunk cannot be mapped
+         */
+        pointer allocate (size_type n) {
+            if (n == 0)
+                throw std::bad_alloc();
+            std::vector<chunk>& v = s->chunks;
+            for (size_type i = v.size(); i != 0; --i) {
+                const pointer p = v[i - 1].try_allocate(n);
+                if (p != 0)
+                    return p;}
+            return grow(n).allocate(n);}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(chunks) in time, plus one munmap when p's chunk empties
+         * frees p in the chunk that owns it, newest first; unmaps that
+         * chunk if it is now empty and not the newest
+         */
+        void deallocate (pointer p, size_type n) {
+            std::vector<chunk>& v = s->chunks;
+            size_type i = v.size();
+            while (i != 0 && !v[i - 1].owns(p))
+                --i;
+            if (i == 0)
+                throw std::logic_error("GrowableAllocator: pointer outside every chunk");
+            v[i - 1].deallocate(p, n);
+            if (i != v.size() && v[i - 1].empty())
+                v.erase(v.begin() + (i - 1));}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // ------
+        // chunks
+        // ------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * how many chunks are mapped
+         */
+        size_type chunks () const {
+            return s->chunks.size();}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(chunks) Allocator::stats calls in time
+         * the chunks' stats summed; largest_free is the largest in any one
+         */
+        allocator_stats stats () const {
+            allocator_stats r = allocator_stats();
+            for (size_type i = 0; i != s->chunks.size(); ++i) {
+                const allocator_stats t = s->chunks[i].stats();
+                r.bytes_used  += t.bytes_used;
+                r.bytes_free  += t.bytes_free;
+                r.used_blocks += t.used_blocks;
+                r.free_blocks += t.free_blocks;
+                r.allocs      += t.allocs;
+                r.frees       += t.frees;
+                r.splits      += t.splits;
+                r.coalesces   += t.coalesces;
+                r.failed      += t.failed;
+                if (t.largest_free > r.largest_free)
+                    r.largest_free = t.largest_free;}
+            return r;}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(1) in space
+         * O(total arena size) in time
+         * checks every chunk
+         */
+        bool isValid () const {
+            for (size_type i = 0; i != s->chunks.size(); ++i)
+                if (!s->chunks[i].isValid())
+                    return false;
+            return true;}};
+
+#endif // GrowableAllocator_h
@@ -0,0 +1,228 @@
+// ------------------------------------
+// projects/allocator/HandleAllocator.h
+// ------------------------------------
+
+#ifndef HandleAllocator_h
+#define HandleAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef>       // ptrdiff_t, size_t
+#include <new>           // bad_alloc
+#include <stdexcept>     // logic_error
+#include <unordered_map> // unordered_map
+#include <vector>        // vector
+
+#include "Allocator.h"
+
+// ---------------
+// HandleAllocator
+// ---------------
+
+/**
+ * an Allocator<T, N, C, F, S> whose blocks are reached through stable
+ * handles instead of pointers, so the arena can be compacted: a handle
+ * is an index into a table of (payload, elements), and get(h) is the
+ * block's current address, good until the next allocate or compact
+ * compact(budget) runs one bounded slice of Allocator::compact and
+ * updates the table; allocate also compacts, fully, before it gives up
+ * not copyable: the table and the arena belong together
+ */
+template <typename T, int N, check_level C = check_local, fit_policy F = first_fit, stats_mode S = stats_on>
+class HandleAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef Allocator<T, N, C, F, S> arena_type;
+
+        typedef std::size_t handle;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        struct entry {
+            pointer   p;    //0 while the handle is free
+            size_type n;};
+
+        arena_type                                   x;
+        std::vector<entry>                           table;
+        std::vector<handle>                          spare;  //free handles
+        std::unordered_map<const_pointer, handle>    owner;  //payload -> handle
+
+        // -----
+        // check
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * throws logic_error unless h names a live block
+         */
+        const entry& check (handle h) const {
+            if (h >= table.size() || table[h].p == 0)
+                throw std::logic_error("HandleAllocator: handle is not live");
+            return table[h];}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        HandleAllocator () :
+                x() {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, over an anonymous mmap region; see Allocator
+         */
+        explicit HandleAllocator (size_type bytes, bool huge = false) :
+                x(bytes, huge) {}
+
+        HandleAllocator (const HandleAllocator&) = delete;
+        HandleAllocator& operator = (const HandleAllocator&) = delete;
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * Allocator::allocate's time; when nothing fits, plus a full
+         * compaction, O(arena size)
+         * a handle to n elements
+         * throws bad_alloc if they do not fit even after compacting, without
+         * compacting when n is 0 or more than all the free space could hold
+         */
+        handle allocate (size_type n) {
+            pointer p = x.try_allocate(n);
+            if (p == 0) {
+                const allocator_stats s = x.stats();
+                // merging every free block also reclaims their sentinels,
+                // so no compaction can offer more than this
+                const size_type room = s.bytes_free + 2 * sizeof(size_type) * s.free_blocks;
+                if (n != 0 && n <= room / sizeof(T)) {
+                    compact(~size_type(0));     //ends any pass an earlier slice left midway,
+                    compact(~size_type(0));}    //so this one covers the whole arena
+                p = x.allocate(n);}
+            handle h = table.size();
+            if (spare.empty())
+                table.push_back(entry());
+            else {
+                h = spare.back();
+                spare.pop_back();}
+            table[h].p = p;
+            table[h].n = n;
+            owner[p] = h;
+            return h;}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * Allocator::deallocate's time
+         * frees h's block; h may be handed out again
+         */
+        void deallocate (handle h) {
+            const entry& e = check(h);
+            x.deallocate(e.p, e.n);
+            owner.erase(e.p);
+            table[h].p = 0;
+            spare.push_back(h);}
+
+        // ---
+        // get
+        // ---
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * h's elements, where they are until the next allocate or compact
+         */
+        pointer get (handle h) const {
+            return check(h).p;}
+
+        // ----
+        // size
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * how many elements h was allocated with
+         */
+        size_type size (handle h) const {
+            return check(h).n;}
+
+        // -------
+        // compact
+        // -------
+
+        /**
+         * O(1) in space
+         * O(budget) in time, see Allocator::compact
+         * one slice of compaction, e.g. between requests; returns whether
+         * it finished a pass over the arena, after which the live blocks
+         * sit packed at its front if none were over-aligned
+         */
+        bool compact (size_type budget) {
+            return x.compact(budget, [this] (pointer from, pointer to) {
+                const typename std::unordered_map<const_pointer, handle>::iterator i = owner.find(from);
+                const handle h = i->second;
+                owner.erase(i);
+                owner[to] = h;
+                table[h].p = to;});}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * the arena's stats; see Allocator::stats
+         */
+        allocator_stats stats () const {
+            return x.stats();}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * the arena is valid and every handle is either live or spare
+         */
+        bool isValid () const {
+            return x.isValid() && owner.size() + spare.size() == table.size();}
+
+        // -----
+        // arena
+        // -----
+
+        /**
+         * the arena, for walk() and histogram()
+         */
+        const arena_type& arena () const {
+            return x;}};
+
+#endif // HandleAllocator_h
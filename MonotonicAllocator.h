@@ -0,0 +1,258 @@
+// ---------------------------------------
+// projects/allocator/MonotonicAllocator.h
+// ---------------------------------------
+
+#ifndef MonotonicAllocator_h
+#define MonotonicAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef> // ptrdiff_t, size_t
+#include <cstdint> // uintptr_t
+#include <new>     // bad_alloc, new
+
+#include "Allocator.h"
+
+// ------------------
+// MonotonicAllocator
+// ------------------
+
+/**
+ * bump-pointer allocator for request-scoped work, over the same arena
+ * storage as Allocator<T, N>: N bytes in the object, or for N == 0 a
+ * runtime-sized buffer shared by every copy (see arena_store)
+ * blocks carry no sentinels and are never coalesced: allocate moves the
+ * top of the arena up, deallocate moves it back only if the block is
+ * the last one handed out and otherwise does nothing, and reset()
+ * reclaims the whole arena at once
+ */
+template <typename T, int N>
+class MonotonicAllocator : private arena_store<N, (alignof(T) > alignof(std::size_t) ? alignof(T) : alignof(std::size_t))> {
+    template <typename, int>
+    friend class MonotonicAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef MonotonicAllocator<U, N> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const MonotonicAllocator& lhs, const MonotonicAllocator& rhs) {
+            return lhs.shares(rhs);}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const MonotonicAllocator& lhs, const MonotonicAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // -----
+        // store
+        // -----
+
+        typedef arena_store<N, (alignof(T) > alignof(std::size_t) ? alignof(T) : alignof(std::size_t))> store;
+
+        using store::a;
+        using store::ctl;
+        using store::shares;
+        using store::size;
+
+        // ---
+        // top
+        // ---
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the offset of the first unallocated byte, kept in the control
+         * block's rover so that copies sharing a runtime arena share it
+         */
+        size_type& top () {
+            return ctl().rover;}
+
+        size_type top () const {
+            return ctl().rover;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        MonotonicAllocator () {
+            static_assert(N != 0, "a runtime-sized arena needs a buffer or a size");
+            reset();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, bumps through the caller's buffer of bytes bytes;
+         * the buffer must outlive every copy
+         */
+        MonotonicAllocator (void* p, size_type bytes) :
+                store(p, bytes) {
+            static_assert(N == 0, "only a runtime-sized arena takes a buffer");
+            reset();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0, bumps through an anonymous mmap region holding at
+         * least bytes bytes, on huge pages if huge
+         */
+        explicit MonotonicAllocator (size_type bytes, bool huge = false) :
+                store(bytes, huge) {
+            static_assert(N == 0, "only a runtime-sized arena takes a size");
+            reset();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N > 0, a rebound copy (e.g. a std::list's node allocator)
+         * starts with its own empty arena; for N == 0 it shares the arena
+         */
+        template <typename U>
+        explicit MonotonicAllocator (const MonotonicAllocator<U, N>& that) :
+                store(static_cast<const typename MonotonicAllocator<U, N>::store&>(that)) {
+            if (N != 0)
+                reset();}
+
+        // Default copy, destructor, and copy assignment
+        // MonotonicAllocator (const MonotonicAllocator&);
+        // ~MonotonicAllocator ();
+        // MonotonicAllocator& operator = (const MonotonicAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * aligns the top for T and moves it past n elements
+         * throws bad_alloc if they do not fit
+         */
+        pointer allocate (size_type n) {
+            const size_type mis = reinterpret_cast<std::uintptr_t>(a + top()) % alignof(T);
+            const size_type i   = (mis == 0) ? top() : top() + alignof(T) - mis;
+            if (n == 0 || i > size() || n > (size() - i) / sizeof(T))
+                throw std::bad_alloc();
+            top() = i + n * sizeof(T);
+            return reinterpret_cast<pointer>(a + i);}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * rolls the top back to p if p's n elements were the last
+         * allocated, so a vector growing in place or a stack of scratch
+         * buffers gives space back; otherwise does nothing until reset
+         */
+        void deallocate (pointer p, size_type n) {
+            if (reinterpret_cast<char*>(p + n) == a + top())
+                top() = reinterpret_cast<char*>(p) - a;}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // -----
+        // reset
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * reclaims the whole arena; every block handed out is invalidated,
+         * including those of copies sharing a runtime arena
+         */
+        void reset () {
+            top() = 0;}
+
+        // ----
+        // used
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * bytes below the top, alignment padding included
+         */
+        size_type used () const {
+            return top();}
+
+        // --------
+        // capacity
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        size_type capacity () const {
+            return size();}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the top lies in the arena
+         */
+        bool isValid () const {
+            return top() <= size();}};
+
+#endif // MonotonicAllocator_h
@@ -0,0 +1,273 @@
+// ----------------------------------
+// projects/allocator/PoolAllocator.h
+// ----------------------------------
+
+#ifndef PoolAllocator_h
+#define PoolAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <atomic>    // atomic
+#include <cstddef>   // ptrdiff_t, size_t
+#include <cstdint>   // uint32_t, uint64_t
+#include <cstring>   // memcpy
+#include <memory>    // make_shared, shared_ptr
+#include <mutex>     // lock_guard, mutex
+#include <new>       // bad_alloc, new
+#include <stdexcept> // logic_error
+
+#include "Allocator.h"
+
+// -------------
+// PoolAllocator
+// -------------
+
+/**
+ * fixed-size pool for single-object allocations
+ * the arena of N bytes is carved into equal slots of at least sizeof(T)
+ * with no per-block sentinels; free slots form a lock-free stack whose
+ * head packs (version, slot index) into one 64-bit word, so a CAS
+ * against a recycled head fails (ABA safe)
+ * allocate(1) and deallocate(p, 1) may be called from any thread;
+ * the pool holds no contiguous runs, so other counts go to a runtime-sized
+ * boundary-tag Allocator<T, 0> of N bytes under a mutex, mapped on the
+ * first such request
+ * copies share the pool and the fallback, and compare equal; a rebound
+ * copy gets its own of each, and does not
+ */
+template <typename T, int N>
+class PoolAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef PoolAllocator<U, N> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const PoolAllocator& lhs, const PoolAllocator& rhs) {
+            return lhs.s == rhs.s;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const PoolAllocator& lhs, const PoolAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ---------
+        // constants
+        // ---------
+
+        const static size_type link_size= sizeof(std::uint32_t);
+        const static size_type slot_align= (alignof(T) > link_size) ? alignof(T) : link_size;
+        const static size_type slot_size= ((sizeof(T) > link_size ? sizeof(T) : link_size) + slot_align - 1) / slot_align * slot_align;
+        const static size_type slot_count= N / slot_size;
+
+        const static std::uint32_t nil= 0xffffffff; //end of the free stack
+
+        // ------
+        // shared
+        // ------
+
+        struct shared {
+            alignas(slot_align) char         a[N];
+            std::atomic<std::uint64_t>       head;  //(version << 32) | index of the top free slot
+            std::mutex                       m;     //guards big
+            std::unique_ptr<Allocator<T, 0> > big;  //allocate(n) for n != 1, once needed
+
+            shared () :
+                    head(0), m(), big() {}};
+
+        // ----
+        // data
+        // ----
+
+        std::shared_ptr<shared> s;
+
+        // ----
+        // next
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the free-stack link stored in slot i
+         */
+        std::uint32_t* next (std::uint32_t i) const {
+            return reinterpret_cast<std::uint32_t*>(&s->a[i * slot_size]);}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * walks the free stack, ensuring every link names a slot
+         * and the stack is no longer than the pool
+         * must not race with allocate or deallocate
+         */
+        bool valid () const {
+            std::uint32_t i = static_cast<std::uint32_t>(s->head.load());
+            size_type     n = 0;
+            while (i != nil) {
+                if (i >= slot_count || ++n > slot_count)
+                    return false;
+                std::memcpy(&i, &s->a[i * slot_size], link_size);}
+            return true;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * links every slot onto the free stack in address order
+         */
+        PoolAllocator () :
+                s(std::make_shared<shared>()) {
+            static_assert(slot_count >= 1, "arena too small for a single slot");
+            static_assert(slot_count < nil, "too many slots for a 32-bit index");
+            for (std::uint32_t i = 0; i != slot_count; ++i)
+                *next(i) = (i + 1 == slot_count) ? nil : i + 1;}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * a rebound copy (e.g. a std::list's node allocator) starts with
+         * its own empty pool, as its slots are a different size
+         */
+        template <typename U>
+        explicit PoolAllocator (const PoolAllocator<U, N>&) :
+                PoolAllocator() {}
+
+        // Default copy, destructor, and copy assignment
+        // PoolAllocator (const PoolAllocator&);
+        // ~PoolAllocator ();
+        // PoolAllocator& operator = (const PoolAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, retried only while other threads win the CAS
+         * pops the top free slot; n != 1 takes Allocator::allocate's time
+         * under the fallback's lock, plus an mmap the first time
+         * throws bad_alloc when the pool, or for n != 1 the fallback, is
+         * out of room
+         */
+        pointer allocate (size_type n) {
+            if (n != 1) {
+                std::lock_guard<std::mutex> g(s->m);
+                if (!s->big)
+                    s->big.reset(new Allocator<T, 0>(N));
+                return s->big->allocate(n);}
+            std::atomic<std::uint64_t>& head = s->head;
+            std::uint64_t h = head.load(std::memory_order_acquire);
+            for (;;) {
+                const std::uint32_t i = static_cast<std::uint32_t>(h);
+                if (i == nil)
+                    throw std::bad_alloc();
+                // may read a slot another thread has just taken; the
+                // version in h then makes the CAS below fail
+                const std::uint32_t j  = __atomic_load_n(next(i), __ATOMIC_RELAXED);
+                const std::uint64_t nh = (((h >> 32) + 1) << 32) | j;
+                if (head.compare_exchange_weak(h, nh, std::memory_order_acquire, std::memory_order_acquire))
+                    return reinterpret_cast<pointer>(&s->a[i * slot_size]);}}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time, retried only while other threads win the CAS
+         * pushes p's slot onto the free stack; n != 1 goes back to the
+         * fallback under its lock
+         * throws logic_error if p is not a slot of this pool, or for
+         * n != 1 nothing was ever taken from the fallback
+         */
+        void deallocate (pointer p, size_type n) {
+            if (p == 0)
+                return;
+            if (n != 1) {
+                std::lock_guard<std::mutex> g(s->m);
+                if (!s->big)
+                    throw std::logic_error("PoolAllocator: pointer outside the fallback");
+                s->big->deallocate(p, n);
+                return;}
+            const char* const q = reinterpret_cast<const char*>(p);
+            if (q < s->a || q >= s->a + slot_count * slot_size || (q - s->a) % slot_size != 0)
+                throw std::logic_error("PoolAllocator: pointer is not a slot of the pool");
+            const std::uint32_t i = static_cast<std::uint32_t>((q - s->a) / slot_size);
+            std::atomic<std::uint64_t>& head = s->head;
+            std::uint64_t h = head.load(std::memory_order_relaxed);
+            std::uint64_t nh;
+            do {
+                __atomic_store_n(next(i), static_cast<std::uint32_t>(h), __ATOMIC_RELAXED);
+                nh = (((h >> 32) + 1) << 32) | i;}
+            while (!head.compare_exchange_weak(h, nh, std::memory_order_release, std::memory_order_relaxed));}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * calls valid, and checks the fallback under its lock
+         */
+        bool isValid () const {
+            std::lock_guard<std::mutex> g(s->m);
+            return valid() && (!s->big || s->big->isValid());}};
+
+#endif // PoolAllocator_h
@@ -0,0 +1,133 @@
+// --------------------------------------
+// projects/allocator/ReplayAllocator.c++
+// --------------------------------------
+
+/*
+To replay a trace:
+    % g++ -pedantic -std=c++17 -Wall -O2 -DNDEBUG ReplayAllocator.c++ -o ReplayAllocator
+
+    % ./ReplayAllocator [trace [arena]] > ReplayAllocator.out
+
+trace is a file written by TraceAllocator; with no trace, a std::list,
+std::map and std::vector workload is recorded to ReplayAllocator.trace
+and replayed
+arena is the size in bytes of the runtime arenas, by default twice the
+trace's peak live bytes plus 64 KiB
+
+Every line after the header is one CSV row:
+    allocator,arena,events,failed,ns_per_op,peak_requested,peak_footprint,peak_frag,frag
+frag is the fragmentation every 1024 events, separated by spaces; fields
+that do not apply are left empty
+every field but ns_per_op is the same from run to run
+*/
+
+// --------
+// includes
+// --------
+
+#include <cstdlib>   // strtoul
+#include <iostream>  // cerr, cout
+#include <list>      // list
+#include <map>       // map
+#include <memory>    // allocator
+#include <stdexcept> // runtime_error
+#include <string>    // string
+#include <vector>    // vector
+
+#include "Allocator.h"
+#include "GrowableAllocator.h"
+#include "TraceAllocator.h"
+
+// ----
+// emit
+// ----
+
+/**
+ * prints one CSV row; a negative arena is printed as an empty field
+ */
+void emit (const std::string& allocator, long arena, const trace_report& r) {
+    using namespace std;
+    cout << allocator << ",";
+    if (arena >= 0)
+        cout << arena;
+    cout << "," << r.events << "," << r.failed << ","
+         << (r.events == 0 ? 0 : r.seconds * 1e9 / r.events) << ","
+         << r.peak_requested << "," << r.peak_footprint << ",";
+    if (!r.frag.empty())
+        cout << r.peak_frag;
+    cout << ",";
+    for (std::size_t i = 0; i != r.frag.size(); ++i)
+        cout << (i == 0 ? "" : " ") << r.frag[i];
+    cout << endl;}
+
+// ------
+// record
+// ------
+
+/**
+ * records a fixed mix of list, map and vector churn to path
+ */
+void record (const std::string& path) {
+    typedef TraceAllocator<std::allocator<int> > A;
+    typedef TraceAllocator<std::allocator<std::pair<const int, int> > > M;
+    A a(path);
+    std::list<int, A> l(a);
+    const std::less<int> c;
+    std::map<int, int, std::less<int>, M> m(c, M(a));
+    std::vector<std::vector<int, A> > v;
+    unsigned r = 1;
+    for (int i = 0; i != 200000; ++i) {
+        r = r * 1103515245 + 12345;
+        const unsigned k = r >> 8;
+        switch (k % 4) {
+            case 0:
+                l.push_back(i);
+                if (l.size() > 1000)
+                    l.pop_front();
+                break;
+            case 1:
+                m[k % 4096] = i;
+                break;
+            case 2:
+                m.erase(k % 4096);
+                break;
+            default:
+                v.push_back(std::vector<int, A>(1 + k % 256, i, a));
+                if (v.size() > 64)
+                    v.erase(v.begin() + k % v.size());}}}
+
+// ----
+// main
+// ----
+
+int main (int argc, char* argv[]) {
+    using namespace std;
+    try {
+        string path = "ReplayAllocator.trace";
+        if (argc > 1)
+            path = argv[1];
+        else
+            record(path);
+        const vector<trace_event> v = read_trace(path);
+
+        typedef std::allocator<char>                              SA;
+        typedef Allocator<char, 0>                                FF;
+        typedef Allocator<char, 0, check_local, next_fit>         NF;
+        typedef Allocator<char, 0, check_local, best_fit>         BF;
+        typedef Allocator<char, 0, check_none>                    CN;
+        typedef GrowableAllocator<char>                           GA;
+
+        cout << "allocator,arena,events,failed,ns_per_op,peak_requested,peak_footprint,peak_frag,frag" << endl;
+        const trace_report s = replay<SA>(v, [] {return new SA;});
+        emit("std::allocator", -1, s);
+
+        const size_t bytes = (argc > 2) ? strtoul(argv[2], 0, 10) : 2 * s.peak_requested + (1 << 16);
+        emit("Allocator/runtime",            bytes, replay<FF>(v, [bytes] {return new FF(bytes);}));
+        emit("Allocator/runtime/next_fit",   bytes, replay<NF>(v, [bytes] {return new NF(bytes);}));
+        emit("Allocator/runtime/best_fit",   bytes, replay<BF>(v, [bytes] {return new BF(bytes);}));
+        emit("Allocator/runtime/check_none", bytes, replay<CN>(v, [bytes] {return new CN(bytes);}));
+        emit("GrowableAllocator",            -1,    replay<GA>(v, [] {return new GA;}));}
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;}
+    return 0;}
@@ -0,0 +1,487 @@
+// -------------------------------------
+// projects/allocator/ShardedAllocator.h
+// -------------------------------------
+
+#ifndef ShardedAllocator_h
+#define ShardedAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <atomic>    // atomic
+#include <cstddef>   // ptrdiff_t, size_t
+#include <cstdint>   // uintptr_t
+#include <cstdio>    // snprintf
+#include <memory>    // shared_ptr, unique_ptr
+#include <mutex>     // lock_guard, mutex, try_to_lock, unique_lock
+#include <new>       // bad_alloc, new
+#include <stdexcept> // logic_error
+#include <thread>    // hardware_concurrency
+#include <vector>    // vector
+
+#include <linux/mempolicy.h> // MPOL_F_ADDR, MPOL_F_NODE, MPOL_PREFERRED
+#include <sched.h>           // sched_getcpu
+#include <sys/mman.h>        // mmap, munmap
+#include <sys/syscall.h>     // SYS_getcpu, SYS_get_mempolicy, SYS_mbind
+#include <unistd.h>          // access, sysconf, syscall
+
+#include "Allocator.h"
+
+// ----
+// numa
+// ----
+
+/**
+ * the CPU and NUMA node the calling thread runs on, how many nodes
+ * there are, the node of a CPU, and the node backing the page at p,
+ * or -1 if that page was never touched
+ * read from glibc, sysfs and raw system calls, so no libnuma is needed;
+ * a machine without NUMA reports one node, 0
+ */
+inline int this_cpu () {
+    const int cpu = sched_getcpu();     //through the vDSO, not a system call
+    return (cpu < 0) ? 0 : cpu;}
+
+inline int this_node () {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    return syscall(SYS_getcpu, &cpu, &node, 0) == 0 ? int(node) : 0;}
+
+inline int node_count () {
+    char path[64];
+    int  n = 0;
+    while (true) {
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", n);
+        if (access(path, F_OK) != 0)
+            return (n == 0) ? 1 : n;
+        ++n;}}
+
+inline int cpu_node (int cpu) {
+    char path[96];
+    for (int k = 0, n = node_count(); k != n; ++k) {
+        std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, k);
+        if (access(path, F_OK) == 0)
+            return k;}
+    return 0;}
+
+inline int page_node (const void* p) {
+    int node = -1;
+    return syscall(SYS_get_mempolicy, &node, 0, 0, p, MPOL_F_NODE | MPOL_F_ADDR) == 0 ? node : -1;}
+
+// --------
+// shard_by
+// --------
+
+/**
+ * what ShardedAllocator keeps one arena for
+ * per_cpu:  each CPU, in the memory of its node
+ * per_node: each NUMA node
+ */
+enum shard_by {per_cpu, per_node};
+
+// ----------------
+// ShardedAllocator
+// ----------------
+
+/**
+ * one boundary-tag Allocator<T, 0> arena per CPU or per NUMA node, each
+ * in its own slice of one mapping whose pages are asked to come from
+ * that shard's node; copies share the shards, a rebound copy gets its own
+ * allocate serves from the calling thread's shard under that shard's
+ * mutex, which only threads on the same CPU or node contend for, and
+ * tries the others in turn when it is full
+ * deallocate frees into the block's own shard when that is the caller's;
+ * a block from another shard is pushed, without waiting on a lock, onto
+ * that shard's remote-free stack, which its owner empties the next time
+ * it takes its mutex (at check_debug it frees under the owner's mutex, as
+ * the payload cannot carry the link)
+ */
+template <typename T, check_level C = check_local, fit_policy F = first_fit, stats_mode S = stats_on>
+class ShardedAllocator {
+    template <typename, check_level, fit_policy, stats_mode>
+    friend class ShardedAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        typedef Allocator<T, 0, C, F, S> arena_type;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef ShardedAllocator<U, C, F, S> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const ShardedAllocator& lhs, const ShardedAllocator& rhs) {
+            return lhs.s == rhs.s;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const ShardedAllocator& lhs, const ShardedAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // -----
+        // shard
+        // -----
+
+        /**
+         * a freed block waiting in a remote-free stack keeps its link and
+         * element count in its payload, which always has room for both;
+         * the count is xored with key, so that a block pushed again can be
+         * told from one whose payload merely holds a small number
+         */
+        struct remote_block {
+            remote_block* next;
+            size_type     tag;};   //n ^ key(this)
+
+        // ---
+        // key
+        // ---
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a word particular to b, unlikely to turn up in a payload
+         */
+        static size_type key (const remote_block* b) {
+            return size_type(reinterpret_cast<std::uintptr_t>(b) * 0x9e3779b97f4a7c15u);}
+
+        struct shard {
+            std::mutex                 m;
+            arena_type                 x;
+            std::atomic<remote_block*> remote;  //blocks freed by other shards' threads
+            int                        node;
+
+            shard (void* p, size_type bytes, int node) :
+                    m(), x(p, bytes), remote(0), node(node) {}
+
+            /**
+             * O(1) in space
+             * O(length of the list) in time
+             * pushes the list from b, linked through next, onto the
+             * remote-free stack
+             */
+            void push (remote_block* b) {
+                remote_block* e = b;
+                while (e->next != 0)
+                    e = e->next;
+                e->next = remote.load(std::memory_order_relaxed);
+                while (!remote.compare_exchange_weak(e->next, b, std::memory_order_release, std::memory_order_relaxed)) {}}
+
+            /**
+             * O(1) in space
+             * O(blocks waiting) in time
+             * frees every block on the remote-free stack; m must be held
+             * if freeing one throws (e.g. a block pushed twice), the ones
+             * behind it go back on the stack before the exception leaves
+             */
+            void drain () {
+                if (remote.load(std::memory_order_relaxed) == 0)
+                    return;
+                remote_block* q = remote.exchange(0, std::memory_order_acquire);
+                while (q != 0) {
+                    remote_block* const next = q->next;
+                    const size_type     n    = q->tag ^ key(q);
+                    q->tag = 0;         //no longer waiting, should it come back in use
+                    try {
+                        x.deallocate(reinterpret_cast<pointer>(q), n);}
+                    catch (...) {
+                        if (next != 0 && next != q)
+                            push(next);
+                        throw;}
+                    q = next;}}};
+
+        // ------
+        // shared
+        // ------
+
+        struct shared {
+            char*                               base;   //the mapping
+            size_type                           slice;  //bytes per shard, a whole number of pages
+            size_type                           bytes;  //as asked for, for rebound copies
+            shard_by                            by;
+            std::vector<std::unique_ptr<shard>> shards;
+            std::vector<size_type>              home;   //CPU -> its shard
+
+            shared (size_type bytes, shard_by by, size_type count) :
+                    base(0), slice(0), bytes(bytes), by(by), shards(), home() {
+                const size_type page = sysconf(_SC_PAGESIZE);
+                if (count == 0)
+                    count = (by == per_node) ? node_count() : std::thread::hardware_concurrency();
+                if (count == 0)
+                    count = 1;
+                slice = (bytes + page - 1) / page * page;
+                void* const p = mmap(0, slice * count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p == MAP_FAILED)
+                    throw std::bad_alloc();
+                base = static_cast<char*>(p);
+                try {
+                    for (size_type i = 0; i != count; ++i) {
+                        const int node = (by == per_node) ? int(i) : cpu_node(int(i));
+                        unsigned long mask = 1UL << (node % (sizeof(mask) * 8));
+                        syscall(SYS_mbind, base + i * slice, slice, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);    //best effort, before any page is touched
+                        shards.push_back(std::unique_ptr<shard>(new shard(base + i * slice, slice, node)));}}
+                catch (...) {
+                    munmap(base, slice * count);
+                    throw;}
+                for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF); ++cpu)
+                    home.push_back(size_type(by == per_node ? cpu_node(int(cpu)) : cpu) % count);}
+
+            shared (const shared&) = delete;
+            shared& operator = (const shared&) = delete;
+
+            ~shared () {
+                const size_type len = slice * shards.size();
+                shards.clear();
+                munmap(base, len);}};
+
+        // ----
+        // data
+        // ----
+
+        std::shared_ptr<shared> s;
+
+        // -----
+        // local
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the calling thread's shard: its CPU's, or its CPU's node's
+         */
+        size_type local () const {
+            const size_type cpu = this_cpu();
+            return (cpu < s->home.size()) ? s->home[cpu] : cpu % s->shards.size();}
+
+        // -----
+        // owner
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the shard p's block came from
+         * throws logic_error if p lies outside every shard
+         */
+        size_type owner (const_pointer p) const {
+            const char* const q = reinterpret_cast<const char*>(p);
+            if (q < s->base || q >= s->base + s->slice * s->shards.size())
+                throw std::logic_error("ShardedAllocator: pointer outside every shard");
+            return (q - s->base) / s->slice;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(shards) in time, plus one mmap; pages are only faulted in
+         * once used
+         * count shards of bytes bytes each, one per CPU or per node by
+         * default
+         */
+        explicit ShardedAllocator (size_type bytes = size_type(1) << 20, shard_by by = per_cpu, size_type count = 0) :
+                s(std::make_shared<shared>(bytes, by, count)) {}
+
+        /**
+         * O(1) in space
+         * O(shards) in time
+         * a rebound copy (e.g. a std::list's node allocator) gets shards
+         * of its own, as many and as large as that's
+         */
+        template <typename U>
+        explicit ShardedAllocator (const ShardedAllocator<U, C, F, S>& that) :
+                s(std::make_shared<shared>(that.s->bytes, that.s->by, that.s->shards.size())) {}
+
+        // Default copy, destructor, and copy assignment
+        // ShardedAllocator (const ShardedAllocator&);
+        // ~ShardedAllocator ();
+        // ShardedAllocator& operator = (const ShardedAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * Allocator::try_allocate's time on the local shard, plus freeing
+         * its waiting remote blocks; the other shards' when it is full
+         * throws bad_alloc if no shard has room, or n is 0, counting the
+         * failure in the local shard's stats
+         */
+        pointer allocate (size_type n) {
+            const size_type k = local();
+            for (size_type j = 0; j != s->shards.size(); ++j) {
+                shard& h = *s->shards[(k + j) % s->shards.size()];
+                std::lock_guard<std::mutex> g(h.m);
+                h.drain();
+                const pointer p = h.x.try_allocate(n);
+                if (p != 0)
+                    return p;}
+            shard& h = *s->shards[k];
+            std::lock_guard<std::mutex> g(h.m);
+            return h.x.allocate(n);}    //one last try, which counts the failure
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * Allocator::deallocate's time on the local shard; a lock-free
+         * push for another shard's block
+         * at check_local and above, logic_error is thrown here, in the
+         * caller, rather than in whichever thread drains the block, if
+         * it is already waiting on the stack, or if it is not in use
+         * there (Allocator::in_use); the latter is only asked when the
+         * owner's mutex is free to take, and otherwise left to the drain,
+         * as is a block two threads push at once
+         */
+        void deallocate (pointer p, size_type n) {
+            shard& h = *s->shards[owner(p)];
+            if (C == check_debug || &h == s->shards[local()].get()) {
+                std::lock_guard<std::mutex> g(h.m);
+                h.drain();
+                h.x.deallocate(p, n);
+                return;}
+            remote_block* const b = reinterpret_cast<remote_block*>(p);
+            if (C != check_none) {
+                std::unique_lock<std::mutex> g(h.m, std::try_to_lock);
+                if (g.owns_lock() && !h.x.in_use(p))
+                    throw std::logic_error("ShardedAllocator: block is not in use");
+                const size_type m = b->tag ^ key(b);
+                if (m != 0 && m <= s->slice / sizeof(T))
+                    throw std::logic_error("ShardedAllocator: block is already waiting to be freed");}
+            b->next = 0;
+            b->tag  = n ^ key(b);
+            h.push(b);}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * O(1) in space
+         * O(blocks waiting) in time
+         * frees every block waiting on a remote-free stack
+         */
+        void flush () {
+            for (size_type i = 0; i != s->shards.size(); ++i) {
+                shard& h = *s->shards[i];
+                std::lock_guard<std::mutex> g(h.m);
+                h.drain();}}
+
+        // ------
+        // shards
+        // ------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        size_type shards () const {
+            return s->shards.size();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the node shard i's memory was bound to
+         */
+        int node (size_type i) const {
+            return s->shards[i]->node;}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(shards) Allocator::stats calls in time, each under its mutex
+         * the shards' stats summed; largest_free is the largest in any
+         * one; a block waiting on a remote-free stack counts as in use
+         */
+        allocator_stats stats () const {
+            allocator_stats r = allocator_stats();
+            for (size_type i = 0; i != s->shards.size(); ++i) {
+                shard& h = *s->shards[i];
+                std::lock_guard<std::mutex> g(h.m);
+                const allocator_stats t = h.x.stats();
+                r.bytes_used  += t.bytes_used;
+                r.bytes_free  += t.bytes_free;
+                r.used_blocks += t.used_blocks;
+                r.free_blocks += t.free_blocks;
+                r.allocs      += t.allocs;
+                r.frees       += t.frees;
+                r.splits      += t.splits;
+                r.coalesces   += t.coalesces;
+                r.failed      += t.failed;
+                if (t.largest_free > r.largest_free)
+                    r.largest_free = t.largest_free;}
+            return r;}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(1) in space
+         * O(total arena size) in time
+         * checks every shard under its mutex
+         */
+        bool isValid () const {
+            for (size_type i = 0; i != s->shards.size(); ++i) {
+                shard& h = *s->shards[i];
+                std::lock_guard<std::mutex> g(h.m);
+                if (!h.x.isValid())
+                    return false;}
+            return true;}};
+
+#endif // ShardedAllocator_h
@@ -0,0 +1,331 @@
+// -----------------------------------
+// projects/allocator/SmallAllocator.h
+// -----------------------------------
+
+#ifndef SmallAllocator_h
+#define SmallAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef>   // ptrdiff_t, size_t
+#include <cstdint>   // uint64_t
+#include <new>       // bad_alloc, new
+#include <stdexcept> // logic_error
+
+#include "Allocator.h"
+
+// ----------
+// small_slot
+// ----------
+
+/**
+ * compile-time slot geometry of an N-byte arena of Ts tracked by one
+ * 64-bit mask: the smallest multiple of alignof(T) that cuts N into at
+ * most 64 slots, and how many slots that makes
+ */
+template <typename T, int N>
+struct small_slot {
+    static constexpr std::size_t at_least = (std::size_t(N) + 63) / 64;
+    static constexpr std::size_t size     = (at_least + alignof(T) - 1) / alignof(T) * alignof(T);
+    static constexpr std::size_t count    = std::size_t(N) / size;};
+
+// --------------
+// SmallAllocator
+// --------------
+
+/**
+ * an arena of at most a few KiB whose whole block map is two machine
+ * words: the N bytes are cut into at most 64 slots of a size fixed at
+ * compile time (see small_slot), with a used bit and a head bit (first
+ * slot of a block) for each, and no per-block metadata at all
+ * a block of n elements takes the slots its n * sizeof(T) bytes cover;
+ * allocate finds the lowest run of free slots with O(log slots) shifts
+ * and one ctz, and deallocate clears the run with one mask
+ * an arena over 4 KiB, or too small for one T, does not compile, even
+ * when T is large enough that 64 slots would cover it; checks at
+ * check_level C, like Allocator
+ */
+template <typename T, int N, check_level C = check_local>
+class SmallAllocator {
+    template <typename, int, check_level>
+    friend class SmallAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        typedef std::uint64_t word;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef SmallAllocator<U, N, C> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const SmallAllocator& lhs, const SmallAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const SmallAllocator& lhs, const SmallAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ---------
+        // constants
+        // ---------
+
+        static constexpr size_type slot  = small_slot<T, N>::size;
+        static constexpr size_type slots = small_slot<T, N>::count;
+        static constexpr word      all   = (slots == 64) ? ~word(0) : (word(1) << slots) - 1;  //one bit per slot
+
+        static_assert(N > 0, "arena size must be positive");
+        static_assert(sizeof(T) <= std::size_t(N), "arena too small for a single T");
+        static_assert(std::size_t(N) <= 64 * 64, "arena larger than 64 slots of 64 bytes; use Allocator");
+
+        // ----
+        // data
+        // ----
+
+        word used;      //bit i set iff slot i is in use
+        word head;      //bit i set iff slot i starts an in-use block
+        alignas(T) char a[slots * slot];
+
+        // ----
+        // span
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the slots n elements cover, 0 if more than the arena has
+         */
+        static constexpr size_type span (size_type n) {
+            return (n == 0 || n > slots * slot / sizeof(T)) ? 0 : (n * sizeof(T) + slot - 1) / slot;}
+
+        // ----
+        // mask
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * k bits from bit i, i + k <= 64
+         */
+        static constexpr word mask (size_type i, size_type k) {
+            return ((k == 64) ? ~word(0) : (word(1) << k) - 1) << i;}
+
+        // ----
+        // runs
+        // ----
+
+        /**
+         * O(1) in space
+         * O(log k) in time
+         * bit i of the result is set iff slots i through i + k - 1 are
+         * free, 0 < k <= slots
+         */
+        static constexpr word runs (word f, size_type k) {
+            for (size_type r = 1; r < k && f != 0; ) {
+                const size_type s = (r < k - r) ? r : k - r;
+                f &= f >> s;
+                r += s;}
+            return f;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        SmallAllocator () :
+                used(0),
+                head(0) {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a rebound copy (e.g. a std::list's node allocator) starts with
+         * its own empty arena, and compares unequal, as Allocator's does
+         */
+        template <typename U>
+        explicit SmallAllocator (const SmallAllocator<U, N, C>&) :
+                SmallAllocator() {}
+
+        // Default copy, destructor, and copy assignment
+        // SmallAllocator (const SmallAllocator&);
+        // ~SmallAllocator ();
+        // SmallAllocator& operator = (const SmallAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(log n) in time
+         * the lowest run of free slots that holds n elements
+         * throws bad_alloc if n is 0 or no run is long enough
+         */
+        pointer allocate (size_type n) {
+            const size_type k = span(n);
+            const word      f = (k == 0) ? 0 : runs(~used & all, k);
+            if (f == 0)
+                throw std::bad_alloc();
+            const size_type i = __builtin_ctzll(f);
+            used |= mask(i, k);
+            head |= word(1) << i;
+            return reinterpret_cast<pointer>(a + i * slot);}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * frees the slots of p's n elements; at check_local and above,
+         * throws logic_error unless p starts an in-use block of exactly
+         * that many slots
+         */
+        void deallocate (pointer p, size_type n) {
+            const char* const q = reinterpret_cast<const char*>(p);
+            const size_type   i = (q - a) / slot;
+            const size_type   k = span(n);
+            if (C != check_none) {
+                if (q < a || q >= a + slots * slot || (q - a) % slot != 0)
+                    throw std::logic_error("SmallAllocator: pointer outside the arena");
+                if ((head & (word(1) << i)) == 0)
+                    throw std::logic_error("SmallAllocator: block is already free");
+                const word next = (i + k < slots) ? word(1) << (i + k) : 0;     //the slot behind the block
+                if (k == 0 || k > slots - i || (used & mask(i, k)) != mask(i, k) || (head & mask(i, k)) != (word(1) << i) ||
+                    (used & ~head & next) != 0)
+                    throw std::logic_error("SmallAllocator: size does not match the block");}
+            used &= ~mask(i, k);
+            head &= ~(word(1) << i);}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // --------
+        // capacity
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the slot size and count the arena was cut into
+         */
+        static constexpr size_type slot_size () {
+            return slot;}
+
+        static constexpr size_type slot_count () {
+            return slots;}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time, one popcount per gauge, one pass per free run
+         * counters are not kept, and read 0
+         */
+        allocator_stats stats () const {
+            allocator_stats r = allocator_stats();
+            r.used_blocks = __builtin_popcountll(head);
+            r.bytes_used  = __builtin_popcountll(used) * slot;
+            r.bytes_free  = slots * slot - r.bytes_used;
+            for (word f = ~used & all; f != 0; ) {
+                const size_type s = __builtin_ctzll(f);
+                const word      t = ~f & ~mask(0, s);       //the first used slot above s, if any
+                const size_type e = (t == 0) ? 64 : __builtin_ctzll(t);
+                ++r.free_blocks;
+                if ((e - s) * slot > r.largest_free)
+                    r.largest_free = (e - s) * slot;
+                f &= (e == 64) ? 0 : ~mask(0, e);}
+            return r;}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * every head bit marks a used slot and no bit lies past the last
+         * slot
+         */
+        bool isValid () const {
+            return (head & ~used) == 0 && (used & ~all) == 0;}
+
+        // ----
+        // owns
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether p points into this arena
+         */
+        bool owns (const void* p) const {
+            return static_cast<const char*>(p) >= a && static_cast<const char*>(p) < a + slots * slot;}
+
+        // -----
+        // empty
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether nothing is allocated
+         */
+        bool empty () const {
+            return used == 0;}};
+
+#endif // SmallAllocator_h
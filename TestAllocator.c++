@@ -21,7 +21,7 @@ To test the program:
     % locate libgtest_main.a
     /usr/lib/libgtest_main.a
 
-    % g++ -pedantic -std=c++0x -Wall TestAllocator.c++ -o TestAllocator -lgtest -lpthread -lgtest_main
+    % g++ -pedantic -std=c++17 -Wall TestAllocator.c++ -o TestAllocator -lgtest -lpthread -lgtest_main
 
     % valgrind TestAllocator > TestAllocator.out
 */
@@ -30,13 +30,32 @@ To test the program:
 // includes
 // --------
 
-#include <algorithm> // count
+#include <algorithm> // count, reverse
+#include <cstdio>    // fclose, fopen, fwrite, remove
+#include <numeric>   // accumulate
+#include <cstdint>   // uintptr_t
 #include <memory>    // allocator
 #include <iostream>  //cout
+#include <list>      // list
+#include <map>       // map
+#include <memory_resource> // pmr
+#include <thread>    // thread
+#include <unordered_map> // unordered_map
+#include <vector>    // vector
 
 #include "gtest/gtest.h"
 
 #include "Allocator.h"
+#include "CachingAllocator.h"
+#include "PoolAllocator.h"
+#include "GrowableAllocator.h"
+#include "MonotonicAllocator.h"
+#include "ArenaResource.h"
+#include "BitmapAllocator.h"
+#include "HandleAllocator.h"
+#include "SmallAllocator.h"
+#include "ShardedAllocator.h"
+#include "TraceAllocator.h"
 
 // -------------
 // TestAllocator
@@ -57,7 +76,27 @@ typedef testing::Types<
             std::allocator<int>,
             std::allocator<double>,
             Allocator<int, 100>,
-            Allocator<double, 100> >
+            Allocator<double, 100>,
+            Allocator<int, 100, check_full>,
+            Allocator<double, 100, check_none>,
+            Allocator<int, 100, check_full, next_fit>,
+            Allocator<double, 100, check_full, best_fit>,
+            Allocator<int, 200, check_debug>,
+            Allocator<double, 200, check_debug, next_fit>,
+            CachingAllocator<int, 100>,
+            CachingAllocator<double, 100>,
+            PoolAllocator<int, 100>,
+            PoolAllocator<double, 100>,
+            GrowableAllocator<int>,
+            GrowableAllocator<double, check_full>,
+            MonotonicAllocator<int, 100>,
+            MonotonicAllocator<double, 100>,
+            BitmapAllocator<int, 100>,
+            BitmapAllocator<double, 100, check_full>,
+            SmallAllocator<int, 100>,
+            SmallAllocator<double, 100, check_none>,
+            ShardedAllocator<int>,
+            ShardedAllocator<double, check_full, best_fit> >
         my_types;
 
 TYPED_TEST_CASE(TestAllocator, my_types);
@@ -107,6 +146,110 @@ TYPED_TEST(TestAllocator, Ten) {
             x.destroy(e);}
         x.deallocate(b, s);}}
 
+TYPED_TEST(TestAllocator, Aligned) {
+    typedef typename TestFixture::allocator_type  allocator_type;
+    typedef typename TestFixture::value_type      value_type;
+    typedef typename TestFixture::pointer         pointer;
+
+    allocator_type x;
+    pointer p[3];
+    for (int i = 0; i != 3; ++i) {
+        p[i] = x.allocate(1);
+        if (p[i] != 0) {
+            ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p[i]) % alignof(value_type));}}
+    for (int i = 0; i != 3; ++i)
+        if (p[i] != 0)
+            x.deallocate(p[i], 1);}
+
+// ---------
+// TestNodes
+// ---------
+
+/**
+ * allocators whose rebound copies share one arena, as the allocator of
+ * node containers; std::unordered_map rebinds a temporary copy for each
+ * bucket array, which a fixed arena (N > 0) would free with the copy
+ */
+template <typename A>
+struct TestNodes : testing::Test {
+    // --------
+    // typedefs
+    // --------
+
+    typedef          A                  allocator_type;
+    typedef typename A::value_type      value_type;
+
+    /**
+     * a fresh allocator; an ArenaAllocator gets its own ArenaResource
+     */
+    template <typename B>
+    static B make (const B*) {
+        return B();}
+
+    template <typename T, check_level C, fit_policy F, stats_mode S>
+    static Allocator<T, 0, C, F, S> make (const Allocator<T, 0, C, F, S>*) {
+        return Allocator<T, 0, C, F, S>(std::size_t(1) << 16);}
+
+    template <typename T>
+    static MonotonicAllocator<T, 0> make (const MonotonicAllocator<T, 0>*) {
+        return MonotonicAllocator<T, 0>(std::size_t(1) << 16);}
+
+    template <typename T, typename R>
+    static ArenaAllocator<T, R> make (const ArenaAllocator<T, R>*) {
+        static R r(std::size_t(1) << 16);
+        return ArenaAllocator<T, R>(r);}
+
+    static allocator_type make () {
+        return make(static_cast<const allocator_type*>(0));}};
+
+typedef testing::Types<
+            std::allocator<int>,
+            Allocator<int, 0>,
+            Allocator<double, 0, check_full, best_fit>,
+            MonotonicAllocator<int, 0>,
+            ArenaAllocator<int>,
+            ArenaAllocator<double, ArenaResource<0, check_full> > >
+        node_types;
+
+TYPED_TEST_CASE(TestNodes, node_types);
+
+TYPED_TEST(TestNodes, List) {
+    typedef typename TestFixture::allocator_type allocator_type;
+    typedef typename TestFixture::value_type     value_type;
+
+    std::list<value_type, allocator_type> x(TestFixture::make());
+    for (int i = 0; i != 20; ++i)
+        x.push_back(i);
+    x.reverse();
+    x.pop_front();
+    ASSERT_EQ(19u, x.size());
+    ASSERT_EQ(171, std::accumulate(x.begin(), x.end(), 0));}
+
+TYPED_TEST(TestNodes, Map) {
+    typedef typename TestFixture::allocator_type                      allocator_type;
+    typedef typename TestFixture::value_type                          value_type;
+    typedef typename allocator_type::template rebind<std::pair<const value_type, int> >::other map_allocator;
+
+    std::map<value_type, int, std::less<value_type>, map_allocator> x(map_allocator(TestFixture::make()));
+    for (int i = 0; i != 20; ++i)
+        x[i % 7] += i;
+    x.erase(3);
+    ASSERT_EQ(6u, x.size());
+    ASSERT_EQ(190 - (3 + 10 + 17), x[0] + x[1] + x[2] + x[4] + x[5] + x[6]);}
+
+TYPED_TEST(TestNodes, UnorderedMap) {
+    typedef typename TestFixture::allocator_type                      allocator_type;
+    typedef typename TestFixture::value_type                          value_type;
+    typedef typename allocator_type::template rebind<std::pair<const value_type, int> >::other map_allocator;
+
+    std::unordered_map<value_type, int, std::hash<value_type>, std::equal_to<value_type>, map_allocator> x(8, std::hash<value_type>(), std::equal_to<value_type>(), map_allocator(TestFixture::make()));
+    for (int i = 0; i != 20; ++i)
+        x[i] = i;
+    x.erase(3);
+    ASSERT_EQ(19u, x.size());
+    ASSERT_EQ(19, x[19]);
+    ASSERT_EQ(0u, x.count(3));}
+
 //-------------
 //valid() tests
 //-------------
@@ -123,7 +266,7 @@ TEST(TestAllocator, valid_2){
 }
 
 TEST(TestAllocator, valid_3){
-  Allocator<int, 100> x;
+  Allocator<int, 128> x;
   int* p1 = x.allocate(5);
   int* p2 = x.allocate(10);
   int* p3 = x.allocate(4);
@@ -167,6 +310,34 @@ TEST(TestAllocator, allocate_3){
   }
 }
 
+TEST(TestAllocator, allocate_4){
+  Allocator<int, 200> x;
+  int* p1 = x.allocate(4);
+  int* p2 = x.allocate(4);
+  int* p3 = x.allocate(4);
+  x.deallocate(p2, 4);
+  int* p4 = x.allocate(8);
+  int* p5 = x.allocate(4);
+  ASSERT_EQ(p3 + 4 + 16 / sizeof(int), p4);
+  ASSERT_EQ(p2, p5);
+  ASSERT_EQ(x.isValid(), true);
+}
+
+TEST(TestAllocator, allocate_5){
+  Allocator<char, 1000> x;
+  char* p[20];
+  for(int i = 0; i < 20; ++i)
+    p[i] = x.allocate(8);
+  for(int i = 0; i < 20; i += 2)
+    x.deallocate(p[i], 8);
+  ASSERT_EQ(x.isValid(), true);
+  char* q = x.allocate(16);
+  ASSERT_EQ(p[18], q);
+  char* r = x.allocate(100);
+  ASSERT_EQ(p[19] + 16 + 16, r);
+  ASSERT_EQ(x.isValid(), true);
+}
+
 //------------------
 //deallocate() tests
 //------------------
@@ -197,3 +368,1316 @@ TEST(TestAllocator, deallocate_3) {
   
   ASSERT_EQ(p2, p3);
 }
+
+TEST(TestAllocator, deallocate_4) {
+  Allocator<int, 100> x;
+  Allocator<int, 100> y = x;		//a copy of an embedded arena is another arena
+  ASSERT_TRUE(x == x);
+  ASSERT_TRUE(x != y);
+  Allocator<double, 100> z;
+  Allocator<int, 100>    w(z);		//so is a rebound copy
+  ASSERT_TRUE(x != w);
+}
+
+//-------------
+//large arenas
+//-------------
+
+TEST(TestAllocator, large_1) {
+  Allocator<char, (1 << 20)>* x = new Allocator<char, (1 << 20)>;
+  char* p1 = x->allocate(300000);
+  char* p2 = x->allocate(500000);
+  ASSERT_EQ(p1 + 300000 + 16, p2);
+  ASSERT_EQ(-300000, x->view(0));
+  ASSERT_EQ(-500000, x->view(300000 + 16));
+  ASSERT_EQ((1 << 20) - 800000 - 48, x->view(800000 + 32));
+  ASSERT_EQ(x->isValid(), true);
+  delete x;
+}
+
+TEST(TestAllocator, large_2) {
+  Allocator<double, (1 << 21)>* x = new Allocator<double, (1 << 21)>;
+  double* p1 = x->allocate(1000);
+  double* p2 = x->allocate(50000);
+  double* p3 = x->allocate(1000);
+  x->deallocate(p1, 1000);
+  x->deallocate(p3, 1000);
+  ASSERT_EQ(x->isValid(), true);
+  x->deallocate(p2, 50000);
+  ASSERT_EQ((1 << 21) - 16, x->view(0));
+  double* p4 = x->allocate(((1 << 21) - 16) / sizeof(double));
+  ASSERT_EQ(p1, p4);
+  ASSERT_EQ(x->isValid(), true);
+  delete x;
+}
+
+TEST(TestAllocator, large_3) {
+  Allocator<int, (1 << 24) + 5>* x = new Allocator<int, (1 << 24) + 5>;
+  int* p[64];
+  for(int i = 0; i < 64; ++i)
+    p[i] = x->allocate(50000 + i);
+  for(int i = 1; i < 64; i += 2)
+    x->deallocate(p[i], 50000 + i);
+  ASSERT_EQ(x->isValid(), true);
+  int* q = x->allocate(100001);
+  ASSERT_EQ(x->isValid(), true);
+  for(int i = 0; i < 64; i += 2)
+    x->deallocate(p[i], 50000 + i);
+  x->deallocate(q, 100001);
+  ASSERT_EQ((1 << 24) + 5 - 16, x->view(0));
+  ASSERT_EQ(x->isValid(), true);
+  delete x;
+}
+
+//----------------------
+//CachingAllocator tests
+//----------------------
+
+TEST(TestAllocator, caching_1) {
+  CachingAllocator<int, 1000> x;
+  int* p1 = x.allocate(1);
+  x.deallocate(p1, 1);
+  int* p2 = x.allocate(1);
+  ASSERT_EQ(p1, p2);
+  x.deallocate(p2, 1);
+  ASSERT_EQ(x.isValid(), true);
+  CachingAllocator<int, 1000> y = x;
+  CachingAllocator<double, 1000> z(x);
+  CachingAllocator<int, 1000> w(z);
+  ASSERT_TRUE(x == y);
+  ASSERT_TRUE(x != w);				//a rebound copy has its own arena
+}
+
+TEST(TestAllocator, caching_2) {
+  CachingAllocator<int, 1000> x;
+  CachingAllocator<int, 1000> y;
+  CachingAllocator<int, 1000> z = x;
+  ASSERT_EQ(x == z, true);
+  ASSERT_EQ(x != y, true);
+  int* p1 = x.allocate(2);
+  int* p2 = y.allocate(2);
+  x.deallocate(p1, 2);
+  y.deallocate(p2, 2);
+  int* p3 = z.allocate(2);
+  ASSERT_EQ(p1, p3);
+  z.deallocate(p3, 2);
+}
+
+TEST(TestAllocator, caching_3) {
+  typedef CachingAllocator<int, (1 << 20)> allocator_type;
+  allocator_type x;
+  std::vector<std::thread> t;
+  std::vector<int> bad(8, 0);
+  for(int k = 0; k < 8; ++k)
+    t.push_back(std::thread([&x, &bad, k] () {
+      int* p[40];
+      for(int r = 0; r < 500; ++r) {
+        for(int i = 0; i < 40; ++i) {
+          p[i] = x.allocate(1 + i % 3);
+          *p[i] = k;}
+        for(int i = 0; i < 40; ++i) {
+          if(*p[i] != k)
+            ++bad[k];
+          x.deallocate(p[i], 1 + i % 3);}}}));
+  for(int k = 0; k < 8; ++k)
+    t[k].join();
+  ASSERT_EQ(std::count(bad.begin(), bad.end(), 0), 8);
+  ASSERT_EQ(x.isValid(), true);
+}
+
+//-------------------
+//PoolAllocator tests
+//-------------------
+
+TEST(TestAllocator, pool_1) {
+  PoolAllocator<double, 24> x;
+  double* p1 = x.allocate(1);
+  double* p2 = x.allocate(1);
+  double* p3 = x.allocate(1);
+  ASSERT_EQ(p1 + 1, p2);
+  ASSERT_EQ(p2 + 1, p3);
+  try{
+    x.allocate(1);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::bad_alloc&) {
+    ASSERT_EQ(0,0);
+  }
+  x.deallocate(p2, 1);
+  ASSERT_EQ(p2, x.allocate(1));
+  ASSERT_EQ(x.isValid(), true);
+}
+
+TEST(TestAllocator, pool_2) {
+  PoolAllocator<char, 100> x;
+  char* p1 = x.allocate(1);
+  char* p2 = x.allocate(1);
+  ASSERT_EQ(p1 + 4, p2);
+  char* p3 = x.allocate(2);			//from the fallback arena
+  ASSERT_NE(p3, (char*)0);
+  ASSERT_EQ(p3 == p1 + 8, false);
+  PoolAllocator<char, 100> y = x;
+  ASSERT_EQ(x == y, true);			//copies share the pool
+  PoolAllocator<char, 100> z;
+  ASSERT_EQ(x != z, true);
+  ASSERT_EQ(y.isValid(), true);
+  y.deallocate(p3, 2);
+  y.deallocate(p2, 1);
+  ASSERT_EQ(p2, x.allocate(1));
+  ASSERT_THROW(z.deallocate(p1, 1), std::logic_error);	//not z's slot
+  ASSERT_THROW(x.deallocate(p1 + 1, 1), std::logic_error);	//not a slot start
+  ASSERT_THROW(z.deallocate(p1, 2), std::logic_error);	//z's fallback was never mapped
+  ASSERT_EQ(x.isValid(), true);
+  std::vector<int, PoolAllocator<char, 1000>::rebind<int>::other> v;
+  for(int i = 0; i < 50; ++i)
+    v.push_back(i);
+  ASSERT_EQ(1225, std::accumulate(v.begin(), v.end(), 0));
+}
+
+TEST(TestAllocator, pool_3) {
+  typedef PoolAllocator<int, 8 * 40 * 4> allocator_type;
+  allocator_type x;
+  std::vector<std::thread> t;
+  std::vector<int> bad(8, 0);
+  for(int k = 0; k < 8; ++k)
+    t.push_back(std::thread([&x, &bad, k] () {
+      int* p[40];
+      for(int r = 0; r < 1000; ++r) {
+        for(int i = 0; i < 40; ++i) {
+          p[i] = x.allocate(1);
+          *p[i] = k;}
+        for(int i = 0; i < 40; ++i) {
+          if(*p[i] != k)
+            ++bad[k];
+          x.deallocate(p[i], 1);}}}));
+  for(int k = 0; k < 8; ++k)
+    t[k].join();
+  ASSERT_EQ(std::count(bad.begin(), bad.end(), 0), 8);
+  ASSERT_EQ(x.isValid(), true);
+  for(int i = 0; i < 8 * 40; ++i)
+    x.allocate(1);
+}
+
+//--------------------------
+//allocate_aligned() tests
+//--------------------------
+
+TEST(TestAllocator, aligned_1) {
+  Allocator<char, 1000> x;
+  char* p1 = x.allocate(3);
+  char* p2 = x.allocate_aligned(10, 16);
+  char* p3 = x.allocate_aligned(10, 32);
+  char* p4 = x.allocate_aligned(10, 64);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p2) % 16);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p3) % 32);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p4) % 64);
+  ASSERT_EQ(x.isValid(), true);
+  x.deallocate(p1, 3);
+  x.deallocate(p3, 10);
+  x.deallocate(p2, 10);
+  x.deallocate(p4, 10);
+  ASSERT_EQ(1000 - 16, x.view(0));
+}
+
+TEST(TestAllocator, aligned_2) {
+  Allocator<double, 2000> x;
+  double* p[12];
+  for(int i = 0; i < 12; ++i) {
+    p[i] = x.allocate_aligned(1 + i, 16 << (i % 3));
+    ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p[i]) % (16 << (i % 3)));
+  }
+  ASSERT_EQ(x.isValid(), true);
+  for(int i = 0; i < 12; i += 2)
+    x.deallocate(p[i], 1 + i);
+  double* q = x.allocate_aligned(2, 64);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(q) % 64);
+  ASSERT_EQ(x.isValid(), true);
+}
+
+TEST(TestAllocator, aligned_3) {
+  Allocator<int, 100> x;
+  try{
+    x.allocate_aligned(1, 24);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::invalid_argument&) {
+    ASSERT_EQ(0,0);
+  }
+  try{
+    x.allocate_aligned(22, 64);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::bad_alloc&) {
+    ASSERT_EQ(0,0);
+  }
+  Allocator<int, 200> y;
+  int* p1 = y.allocate_aligned(1, 64);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p1) % 64);
+  ASSERT_EQ(y.isValid(), true);
+  Allocator<long double, 500> z;
+  for(int i = 1; i < 5; ++i)
+    ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(z.allocate(i)) % alignof(long double));
+  ASSERT_EQ(z.isValid(), true);
+}
+
+//---------------------
+//check_level tests
+//---------------------
+
+TEST(TestAllocator, check_1) {
+  Allocator<int, 100> x;
+  int* p1 = x.allocate(4);
+  x.deallocate(p1, 4);
+  try{
+    x.deallocate(p1, 4);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::logic_error&) {
+    ASSERT_EQ(0,0);
+  }
+}
+
+TEST(TestAllocator, check_2) {
+  Allocator<int, 100> x;
+  int* p1 = x.allocate(4);
+  p1[4] = 7;	//overruns into the footer
+  try{
+    x.deallocate(p1, 4);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::logic_error&) {
+    ASSERT_EQ(0,0);
+  }
+}
+
+TEST(TestAllocator, check_3) {
+  Allocator<int, 100, check_full> x;
+  Allocator<int, 100, check_local> y;
+  int* p1 = x.allocate(1);
+  int* p2 = y.allocate(1);
+  p1[6] = 3;	//overruns into the next block's header
+  p2[6] = 3;
+  y.construct(p2, 1);
+  try{
+    x.construct(p1, 1);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::logic_error&) {
+    ASSERT_EQ(0,0);
+  }
+  ASSERT_EQ(x.isValid(), false);
+  ASSERT_EQ(y.isValid(), false);
+}
+
+//----------------
+//container tests
+//----------------
+
+TEST(TestAllocator, container_1) {
+  std::vector<int, Allocator<int, 1000> > v;
+  for(int i = 0; i < 50; ++i)
+    v.push_back(i);
+  ASSERT_EQ(50u, v.size());
+  ASSERT_EQ(49, v.back());
+  ASSERT_EQ(1225, std::accumulate(v.begin(), v.end(), 0));
+}
+
+TEST(TestAllocator, container_2) {
+  std::list<double, Allocator<double, 2000> > l;
+  for(int i = 0; i < 40; ++i)
+    l.push_back(i);
+  for(int i = 0; i < 20; ++i)
+    l.pop_front();
+  ASSERT_EQ(20u, l.size());
+  ASSERT_EQ(20.0, l.front());
+  ASSERT_EQ(39.0, l.back());
+}
+
+TEST(TestAllocator, container_3) {
+  Allocator<int, 100> x;
+  Allocator<double, 100> y(x);
+  double* p1 = y.allocate(10);
+  ASSERT_EQ(y.isValid(), true);
+  y.deallocate(p1, 10);
+}
+
+//----------------
+//fit_policy tests
+//----------------
+
+TEST(TestAllocator, fit_1) {
+  Allocator<char, 2000, check_full, first_fit> x;
+  char* p1 = x.allocate(300);
+  char* p2 = x.allocate(8);
+  char* p3 = x.allocate(200);
+  char* p4 = x.allocate(8);
+  x.deallocate(p1, 300);
+  x.deallocate(p3, 200);
+  char* p5 = x.allocate(150);
+  ASSERT_EQ(p3, p5);	//head of the class is the last freed
+  x.deallocate(p2, 8);
+  x.deallocate(p4, 8);
+}
+
+TEST(TestAllocator, fit_2) {
+  Allocator<char, 2000, check_full, best_fit> x;
+  char* p1 = x.allocate(200);
+  char* p2 = x.allocate(8);
+  char* p3 = x.allocate(300);
+  char* p4 = x.allocate(8);
+  char* p5 = x.allocate(160);
+  char* p6 = x.allocate(8);
+  x.deallocate(p3, 300);
+  x.deallocate(p1, 200);
+  x.deallocate(p5, 160);
+  char* p7 = x.allocate(170);
+  ASSERT_EQ(p1, p7);	//smallest block that fits
+  char* p8 = x.allocate(150);
+  ASSERT_EQ(p5, p8);
+  ASSERT_EQ(x.isValid(), true);
+  x.deallocate(p2, 8);
+  x.deallocate(p4, 8);
+  x.deallocate(p6, 8);
+}
+
+TEST(TestAllocator, fit_3) {
+  Allocator<int, 1000, check_full, next_fit> x;
+  int* p1 = x.allocate(4);
+  int* p2 = x.allocate(4);
+  int* p3 = x.allocate(4);
+  x.deallocate(p1, 4);
+  int* p4 = x.allocate(4);
+  ASSERT_EQ(p3 + 4 + 16 / sizeof(int), p4);	//searches on from the rover
+  x.deallocate(p2, 4);
+  x.deallocate(p3, 4);
+  x.deallocate(p4, 4);
+  ASSERT_EQ(1000 - 16, x.view(0));
+  int* p5 = x.allocate(4);
+  ASSERT_EQ(p1, p5);	//rover fell back to the coalesced block
+}
+
+//--------------------------------
+//allocate_n() and deallocate_n()
+//--------------------------------
+
+TEST(TestAllocator, batch_1) {
+  Allocator<int, 2000, check_full> x;
+  int* p[32];
+  x.allocate_n(3, p, 32);
+  for(int i = 1; i < 32; ++i)
+    ASSERT_EQ(p[i - 1] + 4 + 16 / sizeof(int), p[i]);	//back to back
+  x.deallocate_n(p, 3, 32);
+  ASSERT_EQ(2000 - 16, x.view(0));
+}
+
+TEST(TestAllocator, batch_2) {
+  Allocator<double, 4000, check_full> x;
+  double* q[10];
+  for(int i = 0; i < 10; ++i)
+    q[i] = x.allocate(4);
+  for(int i = 0; i < 10; i += 2)
+    x.deallocate(q[i], 4);
+  double* p[40];
+  x.allocate_n(4, p, 40);
+  ASSERT_EQ(x.isValid(), true);
+  std::reverse(p, p + 40);
+  x.deallocate_n(p, 4, 40);
+  for(int i = 1; i < 10; i += 2)
+    x.deallocate(q[i], 4);
+  ASSERT_EQ(4000 - 16, x.view(0));
+}
+
+TEST(TestAllocator, batch_3) {
+  Allocator<int, 500> x;
+  int* p[20];
+  try{
+    x.allocate_n(4, p, 20);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::bad_alloc&) {
+    ASSERT_EQ(0,0);
+  }
+  ASSERT_EQ(500 - 16, x.view(0));	//the partial batch was rolled back
+  x.allocate_n(4, p, 2);
+  p[1] = p[0];
+  try{
+    x.deallocate_n(p, 4, 2);
+    ASSERT_EQ(0,1);
+  }
+  catch(std::logic_error&) {
+    ASSERT_EQ(0,0);
+  }
+  Allocator<long double, 1024> y;		//over-aligned: one block at a time
+  long double* q[64];
+  ASSERT_THROW(y.allocate_n(4, q, 64), std::bad_alloc);
+  ASSERT_EQ(0u, y.stats().used_blocks);
+  ASSERT_EQ(y.isValid(), true);
+  Allocator<int, 1024, check_debug> z;		//redzones: one block at a time
+  ASSERT_THROW(z.allocate_n(4, p, 20), std::bad_alloc);
+  z.flush();					//empty the quarantine
+  ASSERT_EQ(0u, z.stats().used_blocks);
+  ASSERT_EQ(1024 - 16, z.view(0));
+}
+
+//-------------
+//stats() tests
+//-------------
+
+TEST(TestAllocator, stats_1) {
+  Allocator<int, 1000> x;
+  allocator_stats s = x.stats();
+  ASSERT_EQ(1000u - 16, s.bytes_free);
+  ASSERT_EQ(1000u - 16, s.largest_free);
+  ASSERT_EQ(0u, s.bytes_used);
+  ASSERT_EQ(1u, s.free_blocks);
+  int* p1 = x.allocate(4);
+  int* p2 = x.allocate(6);
+  int* p3 = x.allocate(2);
+  x.deallocate(p2, 6);
+  s = x.stats();
+  ASSERT_EQ(16u + 16u, s.bytes_used);
+  ASSERT_EQ(2u, s.used_blocks);
+  ASSERT_EQ(2u, s.free_blocks);
+  ASSERT_EQ(24u + (1000 - 32 - 40 - 32 - 16), s.bytes_free);
+  ASSERT_EQ(3u, s.allocs);
+  ASSERT_EQ(1u, s.frees);
+  ASSERT_EQ(3u, s.splits);
+  ASSERT_EQ(0u, s.coalesces);
+  x.deallocate(p1, 4);
+  x.deallocate(p3, 2);
+  s = x.stats();
+  ASSERT_EQ(3u, s.coalesces);	//p1 merges with p2's block, p3 with both sides
+  ASSERT_EQ(1000u - 16, s.largest_free);
+}
+
+TEST(TestAllocator, stats_2) {
+  Allocator<char, 200> x;
+  Allocator<char, 200, check_local, first_fit, stats_off> y;
+  x.allocate(100);
+  y.allocate(100);
+  try{
+    x.allocate(100);
+  }
+  catch(std::bad_alloc&) {}
+  try{
+    x.allocate(1000);
+  }
+  catch(std::bad_alloc&) {}
+  allocator_stats s = x.stats();
+  allocator_stats t = y.stats();
+  ASSERT_EQ(2u, s.failed);
+  ASSERT_EQ(0u, t.failed);
+  ASSERT_EQ(0u, t.allocs);
+  ASSERT_EQ(s.bytes_used, t.bytes_used);
+  ASSERT_EQ(s.bytes_free, t.bytes_free);
+  ASSERT_EQ(s.largest_free, t.largest_free);
+  ASSERT_EQ(s.used_blocks, t.used_blocks);
+  ASSERT_EQ(s.free_blocks, t.free_blocks);
+}
+
+TEST(TestAllocator, stats_3) {
+  Allocator<int, 1000> x;
+  int* p1 = x.allocate(1);
+  x.allocate(8);
+  x.allocate(40);
+  x.deallocate(p1, 1);
+  std::size_t used[Allocator<int, 1000>::hist_bins];
+  std::size_t free[Allocator<int, 1000>::hist_bins];
+  x.histogram(used, free);
+  ASSERT_EQ(1u, used[5]);
+  ASSERT_EQ(1u, used[7]);
+  ASSERT_EQ(1u, free[4]);
+  ASSERT_EQ(2u, std::accumulate(used, used + Allocator<int, 1000>::hist_bins, 0u));
+  int blocks = 0;
+  x.walk([&blocks] (const void*, std::size_t, bool) {++blocks;});
+  ASSERT_EQ(4, blocks);
+}
+
+//--------------------
+//runtime arena tests
+//--------------------
+
+TEST(TestAllocator, runtime_1) {
+  alignas(16) char buf[4096];
+  Allocator<int, 0> x(buf, sizeof(buf));
+  ASSERT_LE(sizeof(x), 64u);
+  ASSERT_TRUE(x.isValid());
+  int* p = x.allocate(10);
+  ASSERT_GE(reinterpret_cast<char*>(p), buf);
+  ASSERT_LT(reinterpret_cast<char*>(p + 10), buf + sizeof(buf));
+  Allocator<int, 0> y = x;
+  ASSERT_TRUE(x == y);
+  ASSERT_EQ(1u, y.stats().used_blocks);
+  y.deallocate(p, 10);
+  ASSERT_EQ(0u, x.stats().used_blocks);
+  ASSERT_TRUE(x.isValid());
+  char small[16];
+  ASSERT_THROW((Allocator<int, 0>(small, sizeof(small))), std::invalid_argument);
+}
+
+TEST(TestAllocator, runtime_2) {
+  Allocator<char, 0> x(std::size_t(1) << 30);
+  Allocator<char, 0> y(std::size_t(1) << 20, true);
+  ASSERT_TRUE(x != y);
+  ASSERT_GE(x.stats().largest_free, std::size_t(1) << 30);
+  char* p = x.allocate(std::size_t(1) << 29);
+  p[0] = 'a';
+  p[(std::size_t(1) << 29) - 1] = 'b';
+  char* q = y.allocate(1000);
+  ASSERT_TRUE(x.isValid());
+  x.deallocate(p, std::size_t(1) << 29);
+  y.deallocate(q, 1000);
+  ASSERT_EQ(1u, x.stats().free_blocks);
+}
+
+TEST(TestAllocator, runtime_3) {
+  typedef Allocator<int, 0, check_full> A;
+  A x(std::size_t(1) << 16);
+  std::list<int, A> l(x);
+  std::vector<int, A> v(x);
+  for (int i = 0; i != 100; ++i) {
+    l.push_back(i);
+    v.push_back(i);}
+  ASSERT_EQ(100u, l.size());
+  ASSERT_EQ(4950, std::accumulate(l.begin(), l.end(), 0));
+  ASSERT_EQ(4950, std::accumulate(v.begin(), v.end(), 0));
+  ASSERT_GT(x.stats().used_blocks, 100u);	//the list's nodes and the vector share x's arena
+  l.clear();
+  v.clear();
+  v.shrink_to_fit();
+  ASSERT_EQ(0u, x.stats().used_blocks);
+}
+
+//----------------------------
+//GrowableAllocator tests
+//----------------------------
+
+TEST(TestAllocator, grow_1) {
+  GrowableAllocator<int> x(1024);
+  ASSERT_EQ(0u, x.chunks());
+  std::vector<int*> p;
+  for (int i = 0; i != 1000; ++i)
+    p.push_back(x.allocate(10));
+  ASSERT_LE(x.chunks(), 7u);		//1 KiB, then doubling past 40000+ bytes
+  ASSERT_TRUE(x.isValid());
+  ASSERT_EQ(1000u, x.stats().used_blocks);
+  for (int i = 0; i != 1000; ++i)
+    x.deallocate(p[i], 10);
+  ASSERT_EQ(1u, x.chunks());		//only the newest is kept
+  ASSERT_EQ(0u, x.stats().used_blocks);
+}
+
+TEST(TestAllocator, grow_2) {
+  GrowableAllocator<char> x(4096);
+  char* p = x.allocate(4000);
+  char* q = x.allocate(100);		//does not fit the rest of the first chunk
+  ASSERT_EQ(2u, x.chunks());
+  char* r = x.allocate(50);		//fits both; the newest chunk is tried first
+  ASSERT_EQ(q + 104 + 16, r);		//right behind q, 100 rounded up to 104
+  ASSERT_EQ(2u, x.chunks());
+  x.deallocate(p, 4000);			//empties the oldest chunk
+  ASSERT_EQ(1u, x.chunks());
+  x.deallocate(r, 50);
+  x.deallocate(q, 100);
+  ASSERT_EQ(1u, x.chunks());
+  ASSERT_THROW(x.deallocate(p, 4000), std::logic_error);
+}
+
+TEST(TestAllocator, grow_3) {
+  typedef GrowableAllocator<int, check_full> A;
+  A x(512);
+  std::list<int, A> l(x);
+  std::vector<int, A> v(x);
+  for (int i = 0; i != 10000; ++i) {
+    l.push_back(i);
+    v.push_back(i);}
+  ASSERT_EQ(49995000, std::accumulate(l.begin(), l.end(), 0));
+  ASSERT_EQ(49995000, std::accumulate(v.begin(), v.end(), 0));
+  ASSERT_LE(x.chunks(), 2u);		//the vector's old buffers empty their chunks
+  ASSERT_TRUE(x.isValid());
+}
+
+//------------
+//stress tests
+//------------
+
+/**
+ * seeded random allocate/deallocate traffic on an A, checked against a
+ * shadow map of the live blocks after every operation: the arena must be
+ * valid, its in-use blocks must be exactly the live ones, the stats must
+ * agree, a failed allocate must be one that fits no free block, and every
+ * block must keep the bytes written to it until it is freed
+ */
+template <typename A>
+void stress (unsigned seed, int ops) {
+  typedef typename A::value_type T;
+  A x;
+  std::map<const char*, std::size_t> live;	//payload -> element count
+  unsigned r = seed;
+  for (int op = 0; op != ops; ++op) {
+    r = r * 1103515245u + 12345u;
+    if (live.empty() || (r >> 16) % 8 < 5) {
+      const std::size_t n = 1 + (r >> 8) % 40;
+      try {
+        T* p = x.allocate(n);
+        const char* c = reinterpret_cast<const char*>(p);
+        ASSERT_EQ(0u, live.count(c));
+        std::fill(reinterpret_cast<unsigned char*>(p), reinterpret_cast<unsigned char*>(p + n), (unsigned char)(std::uintptr_t(c) >> 3));
+        live[c] = n;}
+      catch (std::bad_alloc&) {
+        std::size_t slack = 0;					//padding an over-aligned T may need
+        if (alignof(T) > sizeof(std::size_t))
+          slack = 2 * alignof(T) + 2 * sizeof(std::size_t) + std::max(sizeof(T), 2 * sizeof(std::size_t));
+        ASSERT_LT(x.stats().largest_free, n * sizeof(T) + slack);}}
+    else {
+      typename std::map<const char*, std::size_t>::iterator it = live.begin();
+      std::advance(it, (r >> 8) % live.size());
+      const unsigned char* c = reinterpret_cast<const unsigned char*>(it->first);
+      ASSERT_EQ(it->second * sizeof(T), (std::size_t)std::count(c, c + it->second * sizeof(T), (unsigned char)(std::uintptr_t(c) >> 3)));
+      x.deallocate(reinterpret_cast<T*>(const_cast<char*>(it->first)), it->second);
+      live.erase(it);}
+
+    ASSERT_TRUE(x.isValid());
+    std::size_t used = 0;
+    std::size_t bytes = 0;
+    bool ok = true;
+    x.walk([&] (const void* q, std::size_t s, bool in_use) {
+      bytes += s + 2 * sizeof(std::size_t);
+      if (in_use) {
+        ++used;
+        const typename std::map<const char*, std::size_t>::const_iterator it = live.find(static_cast<const char*>(q));
+        ok = ok && it != live.end() && it->second * sizeof(T) <= s;}});
+    ASSERT_TRUE(ok);
+    ASSERT_EQ(live.size(), used);
+    ASSERT_EQ(live.size(), x.stats().used_blocks);
+    const allocator_stats st = x.stats();
+    ASSERT_EQ(bytes, st.bytes_used + st.bytes_free + 2 * sizeof(std::size_t) * (st.used_blocks + st.free_blocks));}}
+
+TEST(TestAllocator, stress_1) {
+  stress<Allocator<int, 4096> >(1, 20000);
+  stress<Allocator<double, 4096, check_none> >(2, 20000);
+}
+
+TEST(TestAllocator, stress_2) {
+  stress<Allocator<int, 4096, check_full, next_fit> >(3, 20000);
+  stress<Allocator<int, 4096, check_full, best_fit> >(4, 20000);
+}
+
+TEST(TestAllocator, stress_3) {
+  stress<Allocator<char, 1000, check_local, first_fit, stats_off> >(5, 20000);
+  stress<Allocator<long double, 8192> >(6, 20000);
+}
+
+//-------------------------
+//MonotonicAllocator tests
+//-------------------------
+
+TEST(TestAllocator, bump_1) {
+  MonotonicAllocator<int, 100> x;
+  int* p = x.allocate(5);
+  int* q = x.allocate(5);
+  ASSERT_EQ(p + 5, q);
+  ASSERT_EQ(40u, x.used());
+  x.deallocate(p, 5);			//not the last block: nothing happens
+  ASSERT_EQ(40u, x.used());
+  x.deallocate(q, 5);			//the last block: the top rolls back
+  ASSERT_EQ(20u, x.used());
+  ASSERT_EQ(q, x.allocate(20));
+  ASSERT_THROW(x.allocate(1), std::bad_alloc);
+  x.reset();
+  ASSERT_EQ(0u, x.used());
+  ASSERT_EQ(p, x.allocate(25));
+  ASSERT_TRUE(x.isValid());
+}
+
+TEST(TestAllocator, bump_2) {
+  MonotonicAllocator<char, 100> x;
+  x.allocate(3);
+  MonotonicAllocator<double, 100> y(x);	//a rebound copy of a fixed arena starts empty
+  ASSERT_EQ(0u, y.used());
+  MonotonicAllocator<char, 100> v(y);
+  ASSERT_TRUE(v != x);
+  MonotonicAllocator<double, 0> z(std::size_t(1) << 16);
+  z.allocate(1);
+  MonotonicAllocator<char, 0> w(z);	//a rebound copy shares a runtime arena
+  char* c = w.allocate(1);
+  double* d = z.allocate(1);		//aligned past c
+  ASSERT_EQ(reinterpret_cast<char*>(d), c + alignof(double));
+  ASSERT_EQ(24u, z.used());
+  w.reset();
+  ASSERT_EQ(0u, z.used());
+}
+
+TEST(TestAllocator, bump_3) {
+  typedef MonotonicAllocator<int, 0> A;
+  A x(std::size_t(1) << 20);
+  {
+  std::vector<int, A> v(x);
+  std::list<int, A> l(x);
+  for (int i = 0; i != 1000; ++i) {
+    v.push_back(i);
+    l.push_back(i);}
+  ASSERT_EQ(499500, std::accumulate(v.begin(), v.end(), 0));
+  ASSERT_EQ(499500, std::accumulate(l.begin(), l.end(), 0));
+  }
+  ASSERT_GT(x.used(), 1000 * sizeof(int));
+  x.reset();
+  ASSERT_EQ(0u, x.used());
+  std::vector<int, MonotonicAllocator<int, 4096> > w;
+  for (int i = 0; i != 500; ++i)
+    w.push_back(i);			//regrowth rolls back only when the old buffer is on top
+  ASSERT_EQ(124750, std::accumulate(w.begin(), w.end(), 0));
+}
+
+//--------------------
+//ArenaResource tests
+//--------------------
+
+TEST(TestAllocator, resource_1) {
+  ArenaResource<1 << 16> r;
+  std::pmr::list<int> l(&r);
+  std::pmr::vector<double> v(&r);
+  for (int i = 0; i != 100; ++i) {
+    l.push_back(i);
+    v.push_back(i);}
+  ASSERT_EQ(4950, std::accumulate(l.begin(), l.end(), 0));
+  ASSERT_GT(r.arena().stats().used_blocks, 100u);		//both containers are in r
+  ASSERT_TRUE(r.arena().isValid());
+  l.clear();
+  v = std::pmr::vector<double>(&r);
+  ASSERT_EQ(0u, r.arena().stats().used_blocks);
+}
+
+TEST(TestAllocator, resource_2) {
+  ArenaResource<0> r(std::size_t(1) << 16);
+  ArenaResource<0> s(std::size_t(1) << 16);
+  ASSERT_TRUE(r.is_equal(r));
+  ASSERT_FALSE(r.is_equal(s));
+  void* p = static_cast<std::pmr::memory_resource&>(r).allocate(100, 64);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % 64);
+  static_cast<std::pmr::memory_resource&>(r).deallocate(p, 100, 64);
+  ASSERT_EQ(1u, r.arena().stats().free_blocks);
+  ASSERT_THROW(r.allocate_bytes(std::size_t(1) << 20), std::bad_alloc);
+}
+
+TEST(TestAllocator, resource_3) {
+  typedef ArenaResource<0> R;
+  R r(std::size_t(1) << 20);
+  ArenaAllocator<int> a(r);
+  std::vector<int, ArenaAllocator<int> > v(a);
+  std::list<double, ArenaAllocator<double> > l(a);
+  std::map<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int> > > m(a);
+  for (int i = 0; i != 100; ++i) {
+    v.push_back(i);
+    l.push_back(i);
+    m[i] = i;}
+  ASSERT_TRUE(v.get_allocator() == ArenaAllocator<int>(l.get_allocator()));
+  ASSERT_EQ(201u, r.arena().stats().used_blocks);			//one vector buffer, 100 list nodes, 100 map nodes
+  ASSERT_TRUE(r.arena().isValid());
+  const std::size_t n = a.max_size() + 1;				//n * sizeof(int) wraps
+  ASSERT_THROW(a.allocate(n), std::bad_array_new_length);
+  ASSERT_THROW(a.deallocate(&v[0], n), std::bad_array_new_length);
+  ASSERT_EQ(201u, r.arena().stats().used_blocks);
+}
+
+//------------------------------------
+//try_expand() / shrink_in_place() tests
+//------------------------------------
+
+TEST(TestAllocator, expand_1) {
+  Allocator<int, 1000> x;
+  int* p = x.allocate(10);
+  for (int i = 0; i != 10; ++i)
+    p[i] = i;
+  ASSERT_TRUE(x.try_expand(p, 10, 100));		//the rest of the arena is right behind p
+  ASSERT_EQ(45, std::accumulate(p, p + 10, 0));
+  ASSERT_EQ(-400, x.view(0));
+  ASSERT_TRUE(x.isValid());
+  ASSERT_FALSE(x.try_expand(p, 100, 1000));		//more than the arena
+  ASSERT_TRUE(x.try_expand(p, 100, 50));		//already fits
+  ASSERT_EQ(-400, x.view(0));
+}
+
+TEST(TestAllocator, expand_2) {
+  Allocator<int, 1000> x;
+  int* p = x.allocate(10);
+  int* q = x.allocate(10);
+  ASSERT_FALSE(x.try_expand(p, 10, 11));		//q is in the way
+  x.deallocate(q, 10);
+  ASSERT_TRUE(x.try_expand(p, 10, 11));
+  int* r = x.allocate(200);
+  ASSERT_FALSE(x.try_expand(r, 200, 240));		//only 32 bytes left behind r
+  ASSERT_TRUE(x.try_expand(r, 200, 223));		//too little left to split: r gets it all
+  ASSERT_EQ(0u, x.stats().free_blocks);
+  ASSERT_TRUE(x.isValid());
+}
+
+TEST(TestAllocator, expand_3) {
+  Allocator<int, 1000> x;
+  int* p = x.allocate(100);
+  int* q = x.allocate(100);
+  int* r = x.allocate(38);				//the rest of the arena
+  ASSERT_FALSE(x.shrink_in_place(q, 100, 98));		//8 bytes cannot stand alone
+  ASSERT_TRUE(x.shrink_in_place(p, 100, 50));		//the tail stands alone
+  ASSERT_EQ(-200, x.view(0));
+  ASSERT_EQ(184, x.view(216));
+  ASSERT_TRUE(x.shrink_in_place(p, 50, 48));		//the tail joins the free block behind p
+  ASSERT_EQ(192, x.view(208));
+  x.deallocate(r, 38);
+  ASSERT_TRUE(x.shrink_in_place(q, 100, 1));		//the tail joins the free block behind q
+  ASSERT_EQ(2u, x.stats().free_blocks);
+  ASSERT_TRUE(x.isValid());
+  x.deallocate(q, 1);
+  x.deallocate(p, 48);
+  ASSERT_EQ(1u, x.stats().free_blocks);
+  Allocator<int, 1000, check_full, next_fit> y;
+  int* a = y.allocate(10);
+  y.deallocate(y.allocate(1), 1);			//parks the rover right behind a
+  ASSERT_TRUE(y.try_expand(a, 10, 20));
+  ASSERT_TRUE(y.shrink_in_place(a, 20, 5));
+  ASSERT_NE((int*)0, y.allocate(200));
+}
+
+//-----------------
+//check_debug tests
+//-----------------
+
+// the writes into redzones and freed blocks below are the point of these
+// tests; where ASan watches those bytes they would be reported, so they
+// are skipped there (see ALLOCATOR_WATCHED)
+
+TEST(TestAllocator, debug_1) {
+  Allocator<int, 1000, check_debug> x;
+  int* p = x.allocate(5);
+  std::fill(p, p + 5, 7);
+  int* q = x.allocate(5);
+  if(ALLOCATOR_WATCHED) {
+#if defined(__SANITIZE_ADDRESS__)
+    volatile int* r = p;
+    ASSERT_DEATH(r[5] = 0, "use-after-poison");	//ASan stops the write itself
+#endif
+    x.deallocate(p, 5);
+    x.deallocate(q, 5);
+    return;}
+  p[5] = 0;					//one past the end, into the back redzone
+  ASSERT_THROW(x.deallocate(p, 5), std::logic_error);
+  q[-1] = 0;					//into the front redzone
+  ASSERT_THROW(x.deallocate(q, 5), std::logic_error);
+}
+
+TEST(TestAllocator, debug_2) {
+  Allocator<int, 1000, check_debug> x;
+  int* p = x.allocate(5);
+  int* q = x.allocate(5);
+  x.deallocate(p, 5);
+  ASSERT_THROW(x.deallocate(p, 5), std::logic_error);	//still quarantined
+  ASSERT_EQ(2u, x.stats().used_blocks);			//p waits in quarantine
+  x.flush();
+  ASSERT_EQ(1u, x.stats().used_blocks);
+  ASSERT_THROW(x.deallocate(p, 5), std::logic_error);	//out of quarantine and free
+  x.deallocate(q, 5);
+  if(ALLOCATOR_WATCHED)
+    return;
+  q[2] = 1;					//write after free
+  ASSERT_THROW(x.flush(), std::logic_error);
+}
+
+TEST(TestAllocator, debug_3) {
+  Allocator<int, 1000, check_debug> x;
+  int* p[10];
+  for (int k = 0; k != 100; ++k) {		//the quarantine gives its room back when the arena runs dry
+    for (int i = 0; i != 10; ++i)
+      p[i] = x.allocate(5);
+    x.deallocate_n(p, 5, 10);}
+  ASSERT_TRUE(x.isValid());
+  ASSERT_FALSE(x.try_expand(p[0] = x.allocate(5), 5, 6));
+  x.deallocate(p[0], 5);
+  x.flush();
+  ASSERT_EQ(0u, x.stats().used_blocks);
+  Allocator<long double, 2000, check_debug> y;
+  long double* d = y.allocate(3);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(d) % alignof(long double));
+  if(ALLOCATOR_WATCHED) {
+    y.deallocate(d, 3);
+    return;}
+  d[3] = 1;
+  ASSERT_THROW(y.deallocate(d, 3), std::logic_error);
+}
+
+//---------------------
+//TraceAllocator tests
+//---------------------
+
+TEST(TestAllocator, trace_1) {
+  {
+    TraceAllocator<std::allocator<int> > x("TestAllocator.trace");
+    int* p = x.allocate(5);
+    int* q = x.allocate(3);
+    x.deallocate(p, 5);
+    p = x.allocate(2);				//takes the freed id
+    x.deallocate(p, 2);
+    x.deallocate(q, 3);}
+  const std::vector<trace_event> v = read_trace("TestAllocator.trace");
+  std::remove("TestAllocator.trace");
+  ASSERT_EQ(6u, v.size());
+  ASSERT_EQ(0u, v[0].id);
+  ASSERT_EQ(20u, v[0].bytes);
+  ASSERT_EQ(1u, v[1].id);
+  ASSERT_EQ(20u | trace_free, v[2].bytes);
+  ASSERT_EQ(0u, v[3].id);
+  ASSERT_EQ(8u, v[3].bytes);
+  ASSERT_EQ(12u | trace_free, v[5].bytes);
+  for (std::size_t i = 1; i != v.size(); ++i)
+    ASSERT_LE(v[i - 1].ns, v[i].ns);
+  {
+    trace_recorder r("TestAllocator.trace");	//sizes past 32 bits are kept whole
+    const int i = 0;
+    r.allocate(&i, std::size_t(1) << 31);
+    r.deallocate(&i, std::size_t(1) << 33);}
+  const std::vector<trace_event> w = read_trace("TestAllocator.trace");
+  std::remove("TestAllocator.trace");
+  ASSERT_EQ(std::uint64_t(1) << 31, w[0].bytes);
+  ASSERT_EQ((std::uint64_t(1) << 33) | trace_free, w[1].bytes);
+}
+
+TEST(TestAllocator, trace_2) {
+  typedef TraceAllocator<std::allocator<int> > A;
+  {
+    A x("TestAllocator.trace");
+    std::list<int, A> l(x);
+    for (int i = 0; i != 300; ++i) {
+      l.push_back(i);
+      if (i % 3 == 0)
+        l.pop_front();}}
+  const std::vector<trace_event> v = read_trace("TestAllocator.trace");
+  std::remove("TestAllocator.trace");
+  ASSERT_EQ(600u, v.size());
+  typedef Allocator<int, 0, check_local, best_fit> B;
+  const trace_report r = replay<B>(v, [] {return new B(1 << 16);}, 100);
+  const trace_report s = replay<B>(v, [] {return new B(1 << 16);}, 100);
+  ASSERT_EQ(0u, r.failed);
+  ASSERT_EQ(200 * 24u, r.peak_requested);
+  ASSERT_GE(r.peak_footprint, r.peak_requested);
+  ASSERT_EQ(r.peak_footprint, s.peak_footprint);
+  ASSERT_EQ(6u, r.frag.size());
+  ASSERT_TRUE(r.frag == s.frag);
+}
+
+TEST(TestAllocator, trace_3) {
+  const trace_event e[] = {{0, 40, 0}, {1, 400, 1}, {2, 40 | trace_free, 0}, {3, 400 | trace_free, 1}};
+  const std::vector<trace_event> v(e, e + 4);
+  const trace_report r = replay<std::allocator<int> >(v, [] {return new std::allocator<int>;});
+  ASSERT_EQ(440u, r.peak_requested);
+  ASSERT_EQ(440u, r.peak_footprint);
+  ASSERT_TRUE(r.frag.empty());
+  typedef Allocator<int, 100> A;
+  const trace_report s = replay<A>(v, [] {return new A;});
+  ASSERT_EQ(2u, s.failed);			//the 400-byte block and its free
+  ASSERT_EQ(40u, s.peak_requested);
+  ASSERT_THROW(read_trace("TestAllocator.c++"), std::runtime_error);
+  std::FILE* f = std::fopen("TestAllocator.trace", "wb");
+  std::fwrite(trace_magic, 1, sizeof(trace_magic), f);
+  std::fwrite(e, 1, sizeof(e) - 1, f);		//the last event is cut short
+  std::fclose(f);
+  ASSERT_THROW(read_trace("TestAllocator.trace"), std::runtime_error);
+  std::remove("TestAllocator.trace");
+}
+
+//----------------------
+//BitmapAllocator tests
+//----------------------
+
+TEST(TestAllocator, bitmap_1) {
+  BitmapAllocator<int, 1000>* const x = new BitmapAllocator<int, 1000>;
+  ASSERT_EQ(234u, x->capacity());		//64 bytes of bitmap, no sentinels
+  for (std::size_t i = 0; i != x->capacity(); ++i)
+    x->allocate(1);
+  ASSERT_THROW(x->allocate(1), std::bad_alloc);
+  const allocator_stats s = x->stats();
+  ASSERT_EQ(936u, s.bytes_used);
+  ASSERT_EQ(0u, s.bytes_free);
+  ASSERT_EQ(234u, s.used_blocks);
+  ASSERT_TRUE(x->isValid());
+  delete x;
+  Allocator<int, 1000>* const y = new Allocator<int, 1000>;
+  std::size_t n = 0;
+  try {
+    for (;;) {
+      y->allocate(1);
+      ++n;}}
+  catch (const std::bad_alloc&) {}
+  ASSERT_LT(4 * n, 234u);			//two sentinels and a minimum payload each
+  delete y;
+}
+
+TEST(TestAllocator, bitmap_2) {
+  BitmapAllocator<char, 1000> x;
+  char* p = x.allocate(60);
+  char* q = x.allocate(10);			//crosses into the second word
+  char* r = x.allocate(100);
+  ASSERT_EQ(p + 60, q);
+  ASSERT_EQ(q + 10, r);
+  x.deallocate(q, 10);
+  ASSERT_EQ(q, x.allocate(5));			//first fit in address order
+  x.deallocate(p, 60);
+  char* t = x.allocate(65);			//60 + 5 free granules do not fit it
+  ASSERT_EQ(r + 100, t);
+  x.deallocate(q, 5);
+  ASSERT_EQ(p, x.allocate(70));			//a run spanning two words
+  const allocator_stats s = x.stats();
+  ASSERT_EQ(3u, s.used_blocks);
+  ASSERT_EQ(1u, s.free_blocks);
+  ASSERT_EQ(s.bytes_free, s.largest_free);
+  ASSERT_TRUE(x.isValid());
+  BitmapAllocator<char, 1000> y = x;		//a copy holds another arena
+  ASSERT_TRUE(x != y);
+}
+
+TEST(TestAllocator, bitmap_3) {
+  BitmapAllocator<int, 1000> x;
+  int* p = x.allocate(5);
+  int* q = x.allocate(5);
+  ASSERT_THROW(x.deallocate(p, 4), std::logic_error);	//size does not match
+  ASSERT_THROW(x.deallocate(p, 6), std::logic_error);
+  ASSERT_THROW(x.deallocate(p + 1, 4), std::logic_error);
+  int i = 0;
+  ASSERT_THROW(x.deallocate(&i, 1), std::logic_error);
+  x.deallocate(p, 5);
+  ASSERT_THROW(x.deallocate(p, 5), std::logic_error);
+  x.deallocate(q, 5);
+  ASSERT_TRUE(x.empty());
+  ASSERT_EQ(1u, x.stats().free_blocks);
+  ASSERT_EQ(2u, x.stats().frees);
+}
+
+//----------------------
+//HandleAllocator tests
+//----------------------
+
+TEST(TestAllocator, handle_1) {
+  HandleAllocator<int, 1000> x;
+  const HandleAllocator<int, 1000>::handle h = x.allocate(5);
+  const HandleAllocator<int, 1000>::handle k = x.allocate(3);
+  ASSERT_NE(h, k);
+  std::fill(x.get(h), x.get(h) + 5, 7);
+  ASSERT_EQ(5u, x.size(h));
+  x.deallocate(h);
+  ASSERT_THROW(x.get(h), std::logic_error);
+  ASSERT_THROW(x.deallocate(h), std::logic_error);
+  ASSERT_EQ(h, x.allocate(2));			//handles are reused
+  ASSERT_TRUE(x.isValid());
+}
+
+TEST(TestAllocator, handle_2) {
+  typedef HandleAllocator<int, 16000> A;
+  A x;
+  std::vector<A::handle> h;
+  try {
+    for (;;) {
+      h.push_back(x.allocate(10));
+      std::fill(x.get(h.back()), x.get(h.back()) + 10, (int)h.back());}}
+  catch (const std::bad_alloc&) {}
+  for (std::size_t i = 0; i < h.size(); i += 2)
+    x.deallocate(h[i]);
+  const allocator_stats s = x.stats();
+  ASSERT_LT(s.largest_free, 100 * sizeof(int));
+  ASSERT_GT(s.bytes_free, 1000 * sizeof(int));
+  const A::handle big = x.allocate(1000);	//fits only once compacted
+  ASSERT_EQ(1000u, x.size(big));
+  for (std::size_t i = 1; i < h.size(); i += 2)
+    ASSERT_EQ(10, std::count(x.get(h[i]), x.get(h[i]) + 10, (int)h[i]));
+  ASSERT_TRUE(x.isValid());
+}
+
+TEST(TestAllocator, handle_3) {
+  typedef HandleAllocator<double, 0, check_full, best_fit> A;
+  A x(1 << 14);
+  std::vector<A::handle> h;
+  for (int i = 0; i != 100; ++i) {
+    h.push_back(x.allocate(1 + i % 7));
+    std::fill(x.get(h.back()), x.get(h.back()) + x.size(h.back()), i);}
+  for (int i = 0; i < 100; i += 3)
+    x.deallocate(h[i]);
+  ASSERT_GT(x.stats().free_blocks, 30u);
+  const double* const q = x.get(h[1]);
+  ASSERT_THROW(x.allocate(0), std::bad_alloc);
+  ASSERT_THROW(x.allocate(1 << 11), std::bad_alloc);	//more than the arena holds
+  ASSERT_EQ(q, x.get(h[1]));			//neither compacted
+  ASSERT_EQ(2u, x.stats().failed);
+  int slices = 1;
+  while (!x.compact(256))			//bounded slices between requests
+    ++slices;
+  ASSERT_GT(slices, 10);
+  const allocator_stats s = x.stats();
+  ASSERT_EQ(1u, s.free_blocks);
+  ASSERT_EQ(s.bytes_free, s.largest_free);	//every free byte in one block
+  for (int i = 0; i != 100; ++i)
+    if (i % 3 != 0) {
+      ASSERT_EQ(1 + i % 7, std::count(x.get(h[i]), x.get(h[i]) + x.size(h[i]), double(i)));}
+  ASSERT_TRUE(x.isValid());
+  typedef HandleAllocator<double, 8192> B;
+  B y;
+  std::vector<B::handle> g;
+  try {
+    for (;;)
+      g.push_back(y.allocate(4));}
+  catch (const std::bad_alloc&) {}
+  for (std::size_t i = g.size() / 2; i < g.size(); i += 2)
+    y.deallocate(g[i]);
+  ASSERT_FALSE(y.compact(600));			//a slice that stops in the front half
+  for (std::size_t i = 0; i < g.size() / 2; i += 2)
+    y.deallocate(g[i]);				//holes on both sides of where it stopped
+  ASSERT_LT(y.stats().largest_free, 3500u);
+  y.allocate(3500 / 8);				//fits only after a pass over the whole arena
+  ASSERT_TRUE(y.isValid());
+}
+
+//---------------------
+//SmallAllocator tests
+//---------------------
+
+TEST(TestAllocator, small_1) {
+  static_assert(SmallAllocator<int, 100>::slot_size() == 4 && SmallAllocator<int, 100>::slot_count() == 25, "one slot per int");
+  static_assert(SmallAllocator<int, 1000>::slot_size() == 16 && SmallAllocator<int, 1000>::slot_count() == 62, "four ints a slot");
+  static_assert(SmallAllocator<long double, 64>::slot_size() == alignof(long double), "slots keep T's alignment");
+  //none of these compile: an arena over 4 KiB, even of large Ts
+  //  SmallAllocator<char, 4097>
+  //  SmallAllocator<int, 1 << 20>
+  //  SmallAllocator<std::array<char, 1 << 16>, 1 << 22>
+  //nor one too small for a single T
+  //  SmallAllocator<double, 4>
+  SmallAllocator<int, 1000> x;
+  int* p = x.allocate(1);
+  int* q = x.allocate(5);			//two slots
+  int* r = x.allocate(4);
+  ASSERT_EQ(p + 4, q);
+  ASSERT_EQ(q + 8, r);
+  x.deallocate(q, 5);
+  ASSERT_EQ(q, x.allocate(8));
+  ASSERT_EQ(3u, x.stats().used_blocks);
+  ASSERT_EQ(16u * 4, x.stats().bytes_used);
+  SmallAllocator<int, 1000> y(x);		//a copy holds another arena
+  ASSERT_TRUE(x != y);
+}
+
+TEST(TestAllocator, small_2) {
+  SmallAllocator<char, 64> x;
+  char* p[64];
+  for (int i = 0; i != 64; ++i)
+    p[i] = x.allocate(1);
+  ASSERT_THROW(x.allocate(1), std::bad_alloc);
+  for (int i = 0; i < 64; i += 2)
+    x.deallocate(p[i], 1);
+  ASSERT_THROW(x.allocate(2), std::bad_alloc);	//32 free slots, none adjacent
+  const allocator_stats s = x.stats();
+  ASSERT_EQ(32u, s.free_blocks);
+  ASSERT_EQ(1u, s.largest_free);
+  x.deallocate(p[1], 1);
+  ASSERT_EQ(p[0], x.allocate(3));
+  for (int i = 3; i < 64; i += 2)
+    x.deallocate(p[i], 1);
+  x.deallocate(p[0], 3);
+  ASSERT_TRUE(x.empty());
+  ASSERT_EQ(p[0], x.allocate(64));
+}
+
+TEST(TestAllocator, small_3) {
+  SmallAllocator<int, 100> x;
+  int* p = x.allocate(5);
+  int* q = x.allocate(5);
+  ASSERT_THROW(x.deallocate(p, 4), std::logic_error);
+  ASSERT_THROW(x.deallocate(p, 6), std::logic_error);
+  ASSERT_THROW(x.deallocate(p + 1, 4), std::logic_error);
+  int i = 0;
+  ASSERT_THROW(x.deallocate(&i, 1), std::logic_error);
+  x.deallocate(p, 5);
+  ASSERT_THROW(x.deallocate(p, 5), std::logic_error);
+  x.deallocate(q, 5);
+  ASSERT_TRUE(x.empty());
+  ASSERT_TRUE(x.isValid());
+  ASSERT_THROW(x.allocate(26), std::bad_alloc);
+  ASSERT_THROW(x.allocate(0), std::bad_alloc);
+}
+
+//-----------------------
+//ShardedAllocator tests
+//-----------------------
+
+TEST(TestAllocator, sharded_1) {
+  ShardedAllocator<int> x(4096, per_cpu, 3);
+  ASSERT_EQ(3u, x.shards());
+  ShardedAllocator<int> y = x;
+  ASSERT_TRUE(x == y);
+  ASSERT_TRUE(x != ShardedAllocator<int>::rebind<int>::other(ShardedAllocator<double>(4096, per_cpu, 3)));
+  int* p = x.allocate(10);
+  int* q = y.allocate(10);
+  ASSERT_NE(p, q);
+  ASSERT_EQ(2u, x.stats().used_blocks);
+  y.deallocate(p, 10);
+  x.deallocate(q, 10);
+  ASSERT_EQ(0u, y.stats().used_blocks);
+  ASSERT_TRUE(x.isValid());
+  int i = 0;
+  ASSERT_THROW(x.deallocate(&i, 1), std::logic_error);
+  ShardedAllocator<int> z(4096, per_node);
+  ASSERT_EQ(std::size_t(node_count()), z.shards());
+  for(std::size_t k = 0; k < z.shards(); ++k)
+    ASSERT_EQ(int(k), z.node(k));
+}
+
+TEST(TestAllocator, sharded_2) {
+  ShardedAllocator<int> x(4096, per_cpu, 2);
+  std::vector<int*> v;
+  try {
+    while(true)
+      v.push_back(x.allocate(200));}		//the local shard, then the other
+  catch(const std::bad_alloc&) {}
+  ASSERT_GT(v.size(), 4u);
+  ASSERT_EQ(1u, x.stats().failed);
+  ASSERT_THROW(x.allocate(0), std::bad_alloc);
+  ASSERT_EQ(2u, x.stats().failed);
+  for(std::size_t i = 0; i < v.size(); ++i)
+    x.deallocate(v[i], 200);
+  ASSERT_THROW(x.deallocate(v.back(), 200), std::logic_error);	//already waiting on the other shard's stack
+  const std::size_t queued = x.stats().used_blocks;	//the other shard's, on its remote-free stack
+  ASSERT_GT(queued, 0u);
+  ASSERT_LT(queued, v.size());
+  ASSERT_TRUE(x.isValid());
+  x.flush();
+  ASSERT_EQ(0u, x.stats().used_blocks);
+  ASSERT_EQ(v.size(), x.stats().frees);
+  ASSERT_EQ(2u, x.stats().free_blocks);
+  ASSERT_THROW(x.deallocate(v.back(), 200), std::logic_error);	//caught by the caller, not queued
+  ASSERT_THROW(x.deallocate(v.front(), 200), std::logic_error);
+  x.flush();
+  ASSERT_TRUE(x.isValid());
+}
+
+TEST(TestAllocator, sharded_3) {
+  ShardedAllocator<int> x(1 << 16, per_cpu, 4);
+  std::vector<int*> p(8 * 40);
+  std::vector<std::thread> t;
+  for(int k = 0; k < 8; ++k)
+    t.push_back(std::thread([&x, &p, k] () {
+      for(int i = 0; i < 40; ++i) {
+        p[40 * k + i] = x.allocate(1 + i % 3);
+        *p[40 * k + i] = k;}}));
+  for(int k = 0; k < 8; ++k)
+    t[k].join();
+  t.clear();
+  std::vector<int> bad(8, 0);
+  for(int k = 0; k < 8; ++k)
+    t.push_back(std::thread([&x, &p, &bad, k] () {
+      const int o = (k + 1) % 8;			//free the next thread's blocks
+      for(int i = 0; i < 40; ++i) {
+        if(*p[40 * o + i] != o)
+          ++bad[k];
+        x.deallocate(p[40 * o + i], 1 + i % 3);}}));
+  for(int k = 0; k < 8; ++k)
+    t[k].join();
+  ASSERT_EQ(std::count(bad.begin(), bad.end(), 0), 8);
+  x.flush();
+  ASSERT_EQ(0u, x.stats().used_blocks);
+  ASSERT_EQ(8u * 40, x.stats().frees);
+  ASSERT_TRUE(x.isValid());
+}
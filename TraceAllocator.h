@@ -0,0 +1,450 @@
+// -----------------------------------
+// projects/allocator/TraceAllocator.h
+// -----------------------------------
+
+#ifndef TraceAllocator_h
+#define TraceAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <chrono>        // steady_clock
+#include <cstddef>       // ptrdiff_t, size_t
+#include <cstdint>       // uint32_t, uint64_t
+#include <cstdio>        // fclose, fopen, fread, fwrite
+#include <cstring>       // memcmp
+#include <memory>        // shared_ptr
+#include <new>           // bad_alloc, new
+#include <stdexcept>     // runtime_error
+#include <string>        // string
+#include <type_traits>   // false_type, true_type, void_t
+#include <unordered_map> // unordered_map
+#include <utility>       // declval
+#include <vector>        // vector
+
+#include "Allocator.h"
+
+// -----------
+// trace_event
+// -----------
+
+/**
+ * one allocate or deallocate as recorded: 24 bytes in memory and on disk
+ * ns counts from the start of the recording; bytes has trace_free set for
+ * a deallocate; id names the block and is reused once the block is freed,
+ * so ids stay below the peak number of live blocks; unused is 0
+ */
+struct trace_event {
+    std::uint64_t ns;
+    std::uint64_t bytes;
+    std::uint32_t id;
+    std::uint32_t unused;};
+
+const std::uint64_t trace_free = std::uint64_t(1) << 63;
+
+/**
+ * the first eight bytes of a trace file; version 1 had 32-bit sizes
+ */
+const char trace_magic[8] = {'A', 'L', 'L', 'O', 'C', 'T', 'R', '2'};
+
+// ----------
+// read_trace
+// ----------
+
+/**
+ * O(events) in space
+ * O(events) in time
+ * throws runtime_error if path cannot be read, is not a trace file, or
+ * ends partway through an event
+ */
+inline std::vector<trace_event> read_trace (const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == 0)
+        throw std::runtime_error("read_trace: cannot open " + path);
+    char m[sizeof(trace_magic)];
+    if (std::fread(m, 1, sizeof(m), f) != sizeof(m) || std::memcmp(m, trace_magic, sizeof(m)) != 0) {
+        std::fclose(f);
+        throw std::runtime_error("read_trace: not a trace file: " + path);}
+    std::vector<trace_event> v;
+    trace_event e[1024];
+    std::size_t k;
+    while ((k = std::fread(e, 1, sizeof(e), f)) != 0) {
+        v.insert(v.end(), e, e + k / sizeof(trace_event));
+        if (k % sizeof(trace_event) != 0) {
+            std::fclose(f);
+            throw std::runtime_error("read_trace: truncated event in " + path);}}
+    std::fclose(f);
+    return v;}
+
+// --------------
+// trace_recorder
+// --------------
+
+/**
+ * numbers the blocks it sees and appends one trace_event per call to a
+ * binary file, by way of a buffer flushed every 4096 events and when
+ * the recorder is destroyed
+ * not thread-safe, like the allocators it records
+ */
+class trace_recorder {
+    private:
+        // ----
+        // data
+        // ----
+
+        std::FILE*                                      f;
+        std::vector<trace_event>                        buf;
+        std::unordered_map<const void*, std::uint32_t> ids;     //live blocks
+        std::vector<std::uint32_t>                      spare;  //ids of freed blocks
+        std::uint32_t                                   next;   //first id never used
+        std::chrono::steady_clock::time_point           start;
+
+        // ------
+        // append
+        // ------
+
+        void append (std::uint32_t id, std::uint64_t bytes) {
+            const trace_event e = {std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), bytes, id, 0};
+            buf.push_back(e);
+            if (buf.size() == 4096)
+                flush();}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * truncates path and writes the magic
+         * throws runtime_error if path cannot be written
+         */
+        explicit trace_recorder (const std::string& path) :
+                f(std::fopen(path.c_str(), "wb")),
+                buf(),
+                ids(),
+                spare(),
+                next(0),
+                start(std::chrono::steady_clock::now()) {
+            if (f == 0)
+                throw std::runtime_error("trace_recorder: cannot open " + path);
+            std::fwrite(trace_magic, 1, sizeof(trace_magic), f);
+            buf.reserve(4096);}
+
+        trace_recorder (const trace_recorder&) = delete;
+        trace_recorder& operator = (const trace_recorder&) = delete;
+
+        ~trace_recorder () {
+            flush();
+            std::fclose(f);}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) amortized in time
+         * records bytes bytes handed out at p
+         */
+        void allocate (const void* p, std::size_t bytes) {
+            std::uint32_t id = next;
+            if (spare.empty())
+                ++next;
+            else {
+                id = spare.back();
+                spare.pop_back();}
+            ids[p] = id;
+            append(id, bytes);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) amortized in time
+         * records the block at p given back; ignores a p it never saw
+         */
+        void deallocate (const void* p, std::size_t bytes) {
+            const std::unordered_map<const void*, std::uint32_t>::iterator i = ids.find(p);
+            if (i == ids.end())
+                return;
+            append(i->second, std::uint64_t(bytes) | trace_free);
+            spare.push_back(i->second);
+            ids.erase(i);}
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * O(1) in space
+         * O(buffered events) in time
+         */
+        void flush () {
+            std::fwrite(buf.data(), sizeof(trace_event), buf.size(), f);
+            std::fflush(f);
+            buf.clear();}};
+
+// --------------
+// TraceAllocator
+// --------------
+
+/**
+ * wraps an allocator A and records every allocate and deallocate it
+ * serves; copies and rebound copies share one recorder, so a container's
+ * node allocations land in the same trace
+ */
+template <typename A>
+class TraceAllocator {
+    template <typename>
+    friend class TraceAllocator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef typename A::value_type value_type;
+
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type* pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type& reference;
+        typedef const value_type& const_reference;
+
+        // ------
+        // rebind
+        // ------
+
+        template <typename U>
+        struct rebind {
+            typedef TraceAllocator<typename std::allocator_traits<A>::template rebind_alloc<U> > other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const TraceAllocator& lhs, const TraceAllocator& rhs) {
+            return (lhs.x == rhs.x) && (lhs.r == rhs.r);}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const TraceAllocator& lhs, const TraceAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        A                               x;
+        std::shared_ptr<trace_recorder> r;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * records to path, which is truncated
+         */
+        explicit TraceAllocator (const std::string& path, const A& x = A()) :
+                x(x),
+                r(std::make_shared<trace_recorder>(path)) {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a rebound copy converts that's allocator and shares its recorder
+         */
+        template <typename U>
+        explicit TraceAllocator (const TraceAllocator<U>& that) :
+                x(that.x),
+                r(that.r) {}
+
+        // Default copy, destructor, and copy assignment
+        // TraceAllocator (const TraceAllocator&);
+        // ~TraceAllocator ();
+        // TraceAllocator& operator = (const TraceAllocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * A's time, plus O(1) amortized
+         */
+        pointer allocate (size_type n) {
+            const pointer p = x.allocate(n);
+            r->allocate(p, n * sizeof(value_type));
+            return p;}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) value_type(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * A's time, plus O(1) amortized
+         */
+        void deallocate (pointer p, size_type n) {
+            r->deallocate(p, n * sizeof(value_type));
+            x.deallocate(p, n);}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~value_type();}
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * writes out the buffered events, so the file is a complete trace
+         * while the recorder is still alive
+         */
+        void flush () {
+            r->flush();}
+
+        // ---------
+        // allocator
+        // ---------
+
+        const A& allocator () const {
+            return x;}};
+
+// ------------
+// trace_report
+// ------------
+
+/**
+ * what replay measured; every field but seconds is the same from run
+ * to run for the same trace and allocator
+ * footprint is the in-use payload stats() reports, rounding, padding
+ * and redzones included, or the requested bytes for an allocator with
+ * no stats(); frag holds 1 - largest free block / free bytes, sampled
+ * every so many events, and stays empty without stats()
+ */
+struct trace_report {
+    std::size_t         events;
+    std::size_t         failed;          //allocations answered with bad_alloc, and their frees
+    double              seconds;
+    std::size_t         peak_requested;  //live bytes asked for
+    std::size_t         peak_footprint;
+    double              peak_frag;
+    std::vector<double> frag;};
+
+// ---------
+// has_stats
+// ---------
+
+template <typename A, typename = void>
+struct has_stats : std::false_type {};
+
+template <typename A>
+struct has_stats<A, std::void_t<decltype(std::declval<const A&>().stats())> > : std::true_type {};
+
+// ------
+// replay
+// ------
+
+/**
+ * O(peak live blocks) in space
+ * O(events) allocator calls in time
+ * drives allocators from make, which returns a new A on the heap, with
+ * the events in order, ignoring their timestamps, and converts each
+ * size to elements of A::value_type, rounding up
+ * the timed pass touches nothing but its allocator; a second, untimed
+ * pass on a fresh one records the footprint after every event and the
+ * fragmentation every every events
+ */
+template <typename A, typename M>
+trace_report replay (const std::vector<trace_event>& v, M make, std::size_t every = 1024) {
+    typedef typename A::value_type value_type;
+    typedef typename A::pointer    pointer;
+
+    trace_report r = trace_report();
+    r.events = v.size();
+    std::vector<pointer> live;
+    const auto run = [&] (A& x, bool measure) {
+        std::size_t requested = 0;
+        live.clear();
+        for (std::size_t k = 0; k != v.size(); ++k) {
+            const trace_event& e     = v[k];
+            const std::size_t  bytes = e.bytes & ~trace_free;
+            const std::size_t  n     = (bytes == 0) ? 1 : (bytes + sizeof(value_type) - 1) / sizeof(value_type);
+            if (e.id >= live.size())
+                live.resize(e.id + 1, pointer());
+            if ((e.bytes & trace_free) == 0) {
+                try {
+                    live[e.id] = x.allocate(n);
+                    requested += bytes;}
+                catch (const std::bad_alloc&) {
+                    live[e.id] = pointer();
+                    if (measure)
+                        ++r.failed;}}
+            else if (live[e.id] != pointer()) {
+                x.deallocate(live[e.id], n);
+                live[e.id] = pointer();
+                requested -= bytes;}
+            else if (measure)
+                ++r.failed;
+            if (!measure)
+                continue;
+            if (requested > r.peak_requested)
+                r.peak_requested = requested;
+            std::size_t footprint = requested;
+            if constexpr (has_stats<A>::value) {
+                const allocator_stats s = x.stats();
+                footprint = s.bytes_used;
+                if (k % every == every - 1 || k + 1 == v.size()) {
+                    const double f = (s.bytes_free == 0) ? 0 : 1 - double(s.largest_free) / s.bytes_free;
+                    r.frag.push_back(f);
+                    if (f > r.peak_frag)
+                        r.peak_frag = f;}}
+            if (footprint > r.peak_footprint)
+                r.peak_footprint = footprint;}};
+
+    A* x = make();
+    const std::chrono::steady_clock::time_point b = std::chrono::steady_clock::now();
+    run(*x, false);
+    const std::chrono::steady_clock::time_point e = std::chrono::steady_clock::now();
+    r.seconds = std::chrono::duration<double>(e - b).count();
+    delete x;
+    x = make();
+    run(*x, true);
+    delete x;
+    return r;}
+
+#endif // TraceAllocator_h